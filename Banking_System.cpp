@@ -2,14 +2,43 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <array>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
 #include <sstream>
 #include <iomanip>
 #include <ctime>
 #include <cstdlib>
 #include <algorithm>
-#include <conio.h>
+#include <cstring>
 #include <stdexcept>
 #include <limits>  // For numeric_limits
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <filesystem>
+#include <string_view>
+#include <charconv>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <conio.h>
+#include <io.h>
+#else
+#include <termios.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 using namespace std;
 
@@ -19,6 +48,172 @@ using namespace std;
 #define LIGHT_BLUE    "\033[94m"
 #define LIGHT_YELLOW  "\033[93m"
 
+// Get hidden password input
+string getPasswordInput(const string& prompt) {
+    string password;
+    char ch;
+
+    cout << LIGHT_BLUE << prompt << RESET;
+#ifdef _WIN32
+    while ((ch = _getch()) != '\r') {
+        if (ch == '\b' && !password.empty()) {
+            password.pop_back();
+            cout << "\b \b";
+        }
+        else if (ch != '\b') {
+            password.push_back(ch);
+            cout << '*';
+        }
+    }
+#else
+    termios oldt, newt;
+    if (tcgetattr(STDIN_FILENO, &oldt) != 0) {
+        // Not a terminal (piped input): read the line through cin, which may already have buffered it
+        getline(cin, password);
+        if (!password.empty() && password.back() == '\r') password.pop_back();
+        cout << endl;
+        return password;
+    }
+    newt = oldt;
+    newt.c_lflag &= ~(ICANON | ECHO);
+    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+
+    while (read(STDIN_FILENO, &ch, 1) == 1 && ch != '\n' && ch != '\r') {
+        if ((ch == 127 || ch == '\b') && !password.empty()) {
+            password.pop_back();
+            cout << "\b \b";
+        }
+        else if (ch != 127 && ch != '\b') {
+            password.push_back(ch);
+            cout << '*';
+        }
+    }
+    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+#endif
+    cout << endl;
+    return password;
+}
+
+// Fixed-point amount stored as an integer count of the smallest unit
+// (cents with DECIMALS = 2), so balances never drift and formatting and
+// parsing are plain integer work
+class Money {
+public:
+    static constexpr int DECIMALS = 2;
+    static constexpr int64_t SCALE = 100;  // 10^DECIMALS
+
+private:
+    int64_t units = 0;
+
+    explicit constexpr Money(int64_t units) : units(units) {}
+
+public:
+    constexpr Money() = default;
+
+    static constexpr Money fromUnits(int64_t units) { return Money(units); }
+
+    // Nearest representable amount; for records written before Money existed
+    static Money fromDouble(double value) {
+        return Money(static_cast<int64_t>(value * SCALE + (value < 0 ? -0.5 : 0.5)));
+    }
+
+    // Parse "123", "123.4" or "-123.45"; false on anything else, including
+    // more than DECIMALS fraction digits or overflow
+    static bool parse(string_view text, Money& out) {
+        bool negative = !text.empty() && text[0] == '-';
+        if (negative) text.remove_prefix(1);
+        size_t dot = text.find('.');
+        string_view whole = text.substr(0, dot);
+        string_view fraction = dot == string_view::npos ? string_view() : text.substr(dot + 1);
+        if (whole.empty() || fraction.size() > DECIMALS || (dot != string_view::npos && fraction.empty())) {
+            return false;
+        }
+        // from_chars would take a second sign, so "--5.50" would parse as 4.50
+        if (whole.find_first_not_of("0123456789") != string_view::npos) return false;
+
+        int64_t wholeValue = 0;
+        auto r = from_chars(whole.data(), whole.data() + whole.size(), wholeValue);
+        if (r.ec != errc() || r.ptr != whole.data() + whole.size() || wholeValue > INT64_MAX / SCALE - 1) {
+            return false;
+        }
+        int64_t fractionValue = 0;
+        for (size_t i = 0; i < DECIMALS; i++) {
+            char ch = i < fraction.size() ? fraction[i] : '0';
+            if (ch < '0' || ch > '9') return false;
+            fractionValue = fractionValue * 10 + (ch - '0');
+        }
+        int64_t value = wholeValue * SCALE + fractionValue;
+        out = Money(negative ? -value : value);
+        return true;
+    }
+
+    int64_t toUnits() const { return units; }
+
+    // "1234.50": integer formatting into a stack buffer, no streams
+    string toString() const {
+        char buffer[32];
+        char* end = buffer + sizeof(buffer);
+        char* p = end;
+        uint64_t magnitude = units < 0 ? 0 - static_cast<uint64_t>(units) : static_cast<uint64_t>(units);
+        for (int i = 0; i < DECIMALS; i++) {
+            *--p = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        }
+        *--p = '.';
+        do {
+            *--p = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (units < 0) *--p = '-';
+        return string(p, end);
+    }
+
+    // True when *this + other stays in range
+    bool canAdd(Money other) const {
+        return other.units > 0 ? units <= INT64_MAX - other.units : units >= INT64_MIN - other.units;
+    }
+
+    bool isNegative() const { return units < 0; }
+    bool isPositive() const { return units > 0; }
+
+    Money operator+(Money other) const {
+        if ((other.units > 0 && units > INT64_MAX - other.units) || (other.units < 0 && units < INT64_MIN - other.units)) {
+            throw overflow_error("Amount out of range.");
+        }
+        return Money(units + other.units);
+    }
+
+    Money operator-(Money other) const {
+        if (other.units == INT64_MIN) throw overflow_error("Amount out of range.");
+        return *this + Money(-other.units);
+    }
+
+    Money& operator+=(Money other) { return *this = *this + other; }
+    Money& operator-=(Money other) { return *this = *this - other; }
+
+    bool operator==(Money other) const { return units == other.units; }
+    bool operator!=(Money other) const { return units != other.units; }
+    bool operator<(Money other) const { return units < other.units; }
+    bool operator<=(Money other) const { return units <= other.units; }
+    bool operator>(Money other) const { return units > other.units; }
+    bool operator>=(Money other) const { return units >= other.units; }
+};
+
+ostream& operator<<(ostream& out, Money amount) {
+    return out << amount.toString();
+}
+
+// Read a money amount typed at the console
+Money readMoney() {
+    string text;
+    cin >> text;
+    Money amount;
+    if (!Money::parse(text, amount)) {
+        throw invalid_argument("Invalid amount '" + text + "'. Use a number with at most " + to_string(Money::DECIMALS) + " decimal places.");
+    }
+    return amount;
+}
+
 class Customer {
 public:
     string name;
@@ -48,29 +243,28 @@ public:
 class Account {
 private:
     string accountNumber;
-    double balance;
+    Money balance;
 
 public:
     Account(string accountNumber) {
         this->accountNumber = accountNumber;
-        this->balance = 0.0;
     }
 
     string getAccountNumber() const {
         return accountNumber;
     }
 
-    double getBalance() const {
+    Money getBalance() const {
         return balance;
     }
 
-    void deposit(double amount) {
-        if (amount < 0) throw invalid_argument("Deposit amount cannot be negative.");
+    void deposit(Money amount) {
+        if (amount.isNegative()) throw invalid_argument("Deposit amount cannot be negative.");
         balance += amount;
     }
 
-    bool withdraw(double amount) {
-        if (amount < 0) throw invalid_argument("Withdrawal amount cannot be negative.");
+    bool withdraw(Money amount) {
+        if (amount.isNegative()) throw invalid_argument("Withdrawal amount cannot be negative.");
         if (amount <= balance) {
             balance -= amount;
             return true;
@@ -78,233 +272,2443 @@ public:
         throw runtime_error("Insufficient funds.");
     }
 
-    void transfer(Account& target, double amount) {
+    // All or nothing: the credit is computed (and checked for overflow)
+    // before any money leaves this account
+    void transfer(Account& target, Money amount) {
+        if (&target == this) throw invalid_argument("Cannot transfer to the same account.");
+        if (amount.isNegative()) throw invalid_argument("Transfer amount cannot be negative.");
+        Money credited = target.balance + amount;
         if (withdraw(amount)) {
-            target.deposit(amount);
+            target.balance = credited;
         }
     }
 
     string toString() const {
-        stringstream ss;
-        ss << fixed << setprecision(2) << balance;
-        return accountNumber + "," + ss.str() + "\n";
+        return accountNumber + "," + balance.toString() + "\n";
+    }
+};
+
+// Snowflake-style transaction IDs: [41 bits of milliseconds since EPOCH_MS]
+// [10 bits of node][12 bits of sequence]. All threads share one atomic word
+// updated by compare-and-swap, so IDs are unique and strictly increasing
+// without a lock; a full sequence borrows the next millisecond instead of
+// waiting. The node comes from BANK_NODE_ID (0-1023), so processes sharing a
+// ledger must use different nodes. Restarts call advancePast() with the
+// highest ID already in the ledger, so a clock that went backwards cannot
+// reissue an ID.
+class IdGenerator {
+private:
+    static const int64_t EPOCH_MS = 1704067200000LL;  // 2024-01-01T00:00:00Z
+    static const int SEQUENCE_BITS = 12;
+    static const int NODE_BITS = 10;
+    static const uint64_t SEQUENCE_MASK = (1u << SEQUENCE_BITS) - 1;
+    static const uint64_t NODE_MASK = (1u << NODE_BITS) - 1;
+    static const int TIME_SHIFT = SEQUENCE_BITS + NODE_BITS;
+
+    atomic<uint64_t> last{ 0 };
+    uint64_t node = 0;
+
+    uint64_t compose(uint64_t millis, uint64_t sequence) const {
+        return (millis << TIME_SHIFT) | (node << SEQUENCE_BITS) | sequence;
+    }
+
+    // Smallest ID of this node above prev
+    uint64_t after(uint64_t prev) const {
+        uint64_t millis = prev >> TIME_SHIFT;
+        uint64_t sequence = prev & SEQUENCE_MASK;
+        bool sameNode = ((prev >> SEQUENCE_BITS) & NODE_MASK) == node;
+        if (sameNode && sequence < SEQUENCE_MASK) return compose(millis, sequence + 1);
+        if (!sameNode && node > ((prev >> SEQUENCE_BITS) & NODE_MASK)) return compose(millis, 0);
+        return compose(millis + 1, 0);
+    }
+
+public:
+    IdGenerator() {
+        if (const char* value = getenv("BANK_NODE_ID")) node = strtoull(value, nullptr, 10) & NODE_MASK;
+    }
+
+    uint64_t next() {
+        int64_t millis = chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count() - EPOCH_MS;
+        uint64_t now = compose(static_cast<uint64_t>(max<int64_t>(millis, 0)), 0);
+        uint64_t prev = last.load(memory_order_relaxed);
+        uint64_t id;
+        do {
+            id = max(now, after(prev));
+        } while (!last.compare_exchange_weak(prev, id, memory_order_relaxed));
+        return id;
+    }
+
+    // Never issue an ID at or below floor
+    void advancePast(uint64_t floor) {
+        uint64_t prev = last.load(memory_order_relaxed);
+        while (prev < floor && !last.compare_exchange_weak(prev, floor, memory_order_relaxed)) {
+        }
     }
 };
 
+IdGenerator transactionIds;
+
+// Transactions keep their time as microseconds since the Unix epoch and only
+// format it for display. Each thread caches the local "dd-mm-yyyy hh:mm:"
+// text of the last minute it formatted, so printing a run of rows calls
+// localtime once per minute instead of once per row. Timezone offsets are
+// whole minutes, so every UTC minute is exactly one local minute.
+
+int64_t currentTimestamp() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// "17-10-2026 20:44:01" in local time
+string formatTimestamp(int64_t micros) {
+    struct MinuteCache {
+        int64_t minute = INT64_MIN;
+        char prefix[32];
+        size_t length = 0;
+    };
+    thread_local MinuteCache cache;
+
+    int64_t seconds = micros / 1000000 - (micros % 1000000 < 0 ? 1 : 0);
+    int64_t minute = seconds / 60 - (seconds % 60 < 0 ? 1 : 0);
+    if (minute != cache.minute) {
+        time_t t = static_cast<time_t>(minute * 60);
+        struct tm local;
+#ifdef _WIN32
+        localtime_s(&local, &t);
+#else
+        localtime_r(&t, &local);
+#endif
+        int n = snprintf(cache.prefix, sizeof(cache.prefix), "%02d-%02d-%04d %02d:%02d:",
+            local.tm_mday, local.tm_mon + 1, local.tm_year + 1900, local.tm_hour, local.tm_min);
+        cache.length = n > 0 ? min<size_t>(static_cast<size_t>(n), sizeof(cache.prefix) - 1) : 0;
+        cache.minute = minute;
+    }
+
+    int second = static_cast<int>(seconds - minute * 60);
+    string text(cache.prefix, cache.length);
+    text += static_cast<char>('0' + second / 10);
+    text += static_cast<char>('0' + second % 10);
+    return text;
+}
+
+// Parse a stored timestamp: microseconds since the epoch, or a "d-m-yyyy"
+// date written before timestamps were kept (taken as local midnight)
+bool parseTimestamp(string_view text, int64_t& micros) {
+    // A date starts with a digit and has two '-' separators after it; a
+    // leading '-' is the sign of a timestamp before 1970
+    bool date = !text.empty() && text[0] >= '0' && text[0] <= '9' && count(text.begin() + 1, text.end(), '-') == 2;
+    if (!date) {
+        auto r = from_chars(text.data(), text.data() + text.size(), micros);
+        return r.ec == errc() && r.ptr == text.data() + text.size();
+    }
+
+    int parts[3];
+    const char* p = text.data();
+    const char* end = text.data() + text.size();
+    for (int i = 0; i < 3; i++) {
+        auto r = from_chars(p, end, parts[i]);
+        if (r.ec != errc() || (i < 2 ? (r.ptr == end || *r.ptr != '-') : r.ptr != end)) return false;
+        p = r.ptr + 1;
+    }
+    struct tm local = {};
+    local.tm_mday = parts[0];
+    local.tm_mon = parts[1] - 1;
+    local.tm_year = parts[2] - 1900;
+    local.tm_isdst = -1;
+    time_t t = mktime(&local);
+    if (t == static_cast<time_t>(-1)) return false;
+    micros = static_cast<int64_t>(t) * 1000000;
+    return true;
+}
+
 class Transaction {
 private:
     string transactionId;
     string fromAccount;
     string toAccount;
-    double amount;
-    string date;
+    Money amount;
+    int64_t timestamp = 0;  // Microseconds since the Unix epoch
 
 public:
-    Transaction(string transactionId, string fromAccount, string toAccount, double amount, string date)
-        : transactionId(transactionId), fromAccount(fromAccount), toAccount(toAccount), amount(amount), date(date) {}
+    Transaction(string transactionId, string fromAccount, string toAccount, Money amount, int64_t timestamp)
+        : transactionId(move(transactionId)), fromAccount(move(fromAccount)), toAccount(move(toAccount)), amount(amount), timestamp(timestamp) {}
 
-    Transaction(string fromAccount, string toAccount, double amount) {
+    Transaction(string fromAccount, string toAccount, Money amount) {
         this->transactionId = generateTransactionId();
         this->fromAccount = fromAccount;
         this->toAccount = toAccount;
         this->amount = amount;
-        this->date = getCurrentDate();
+        this->timestamp = currentTimestamp();
     }
 
+    string getTransactionId() const { return transactionId; }
+    string getFromAccount() const { return fromAccount; }
+    string getToAccount() const { return toAccount; }
+    Money getAmount() const { return amount; }
+    int64_t getTimestamp() const { return timestamp; }
+    string getDate() const { return formatTimestamp(timestamp); }
+
     string generateTransactionId() {
-        return to_string(rand() % 1000000 + 1);
+        return to_string(transactionIds.next());
     }
 
-    string getCurrentDate() {
-        time_t t = time(0);
-        struct tm now;
-        localtime_s(&now, &t);
-        stringstream ss;
-        ss << now.tm_mday << "-" << now.tm_mon + 1 << "-" << now.tm_year + 1900;
-        return ss.str();
+    // Ledger row, with the raw timestamp
+    string toString() const {
+        return transactionId + "," + fromAccount + "," + toAccount + "," + amount.toString() + "," + to_string(timestamp) + "\n";
     }
 
-    string toString() const {
-        stringstream ss;
-        ss << fixed << setprecision(2) << amount;
-        return transactionId + "," + fromAccount + "," + toAccount + "," + ss.str() + "," + date + "\n";
+    // Row for people to read, with the formatted local time
+    string toDisplayString() const {
+        return transactionId + "," + fromAccount + "," + toAccount + "," + amount.toString() + "," + getDate() + "\n";
     }
 };
 
-class BankingSystem {
+// ---------- Durable file helpers ----------
+
+bool syncFile(int handle) {
+#ifdef _WIN32
+    return _commit(handle) == 0;
+#elif defined(__APPLE__)
+    return fsync(handle) == 0;
+#else
+    return fdatasync(handle) == 0;
+#endif
+}
+
+bool writeAll(int handle, const char* data, size_t length) {
+    while (length > 0) {
+#ifdef _WIN32
+        int n = _write(handle, data, static_cast<unsigned>(length));
+#else
+        ssize_t n = ::write(handle, data, length);
+#endif
+        if (n <= 0) return false;
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+int openFile(const string& path, int flags) {
+#ifdef _WIN32
+    return _open(path.c_str(), flags | _O_BINARY, 0644);
+#else
+    return ::open(path.c_str(), flags, 0644);
+#endif
+}
+
+void closeFile(int handle) {
+#ifdef _WIN32
+    _close(handle);
+#else
+    ::close(handle);
+#endif
+}
+
+// Make renames in the working directory durable (no-op on Windows)
+void syncDirectory() {
+#ifndef _WIN32
+    int dir = ::open(".", O_RDONLY);
+    if (dir >= 0) {
+        fsync(dir);
+        ::close(dir);
+    }
+#endif
+}
+
+// Replace path with contents atomically: write a temp file, fsync it, rename it over path
+void writeFileAtomically(const string& path, const string& contents) {
+    string temp = path + ".tmp";
+    int fd = openFile(temp, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) throw runtime_error("Unable to create '" + temp + "'.");
+    bool ok = writeAll(fd, contents.data(), contents.size()) && syncFile(fd);
+    closeFile(fd);
+    if (!ok) throw runtime_error("Unable to write '" + temp + "'.");
+    filesystem::rename(temp, path);
+    syncDirectory();
+}
+
+// Append contents to path and fsync; returns the new file size
+uint64_t appendFileDurably(const string& path, const string& contents) {
+    int fd = openFile(path, O_WRONLY | O_CREAT | O_APPEND);
+    if (fd < 0) throw runtime_error("Unable to open '" + path + "' for appending.");
+    bool ok = writeAll(fd, contents.data(), contents.size()) && syncFile(fd);
+    closeFile(fd);
+    if (!ok) throw runtime_error("Unable to append to '" + path + "'.");
+    return filesystem::file_size(path);
+}
+
+// ---------- Fast text loading ----------
+
+// Read-only view of a whole file: memory-mapped on POSIX, read into a
+// buffer on Windows. Missing files map as empty.
+class MappedFile {
 private:
-    vector<Customer> customers;
-    vector<Account> accounts;
-    vector<Transaction> transactions;
-    Customer* currentCustomer = nullptr;
+    const char* base = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    string buffer;
+#endif
 
 public:
-    BankingSystem() {
-        try {
-            loadCustomers();
-            loadAccounts();
-            loadTransactions();
-        }
-        catch (const exception& e) {
-            cout << LIGHT_RED << "Error loading data: " << e.what() << RESET << endl;
+    explicit MappedFile(const string& path) {
+#ifdef _WIN32
+        ifstream file(path, ios::binary);
+        if (!file.is_open()) return;
+        buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        base = buffer.data();
+        length = buffer.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* p = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                base = static_cast<const char*>(p);
+                length = static_cast<size_t>(info.st_size);
+                madvise(p, length, MADV_SEQUENTIAL);
+            }
         }
+        ::close(fd);
+#endif
     }
 
-    void loadCustomers() {
-        ifstream file("customers.txt");
-        if (!file.is_open()) {
-            throw runtime_error("Unable to open 'customers.txt' file. Please make sure the file exists and is accessible.");
-        }
-        string line;
-        while (getline(file, line)) {
-            stringstream ss(line);
-            string name, id, password;
-            getline(ss, id, ',');
-            getline(ss, name, ',');
-            getline(ss, password, ',');
-            customers.push_back(Customer(name, id, password));
-        }
-        file.close();
+    ~MappedFile() {
+#ifndef _WIN32
+        if (base) munmap(const_cast<char*>(base), length);
+#endif
     }
 
-    void loadAccounts() {
-        ifstream file("accounts.txt");
-        if (!file.is_open()) {
-            throw runtime_error("Unable to open accounts file.");
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    string_view view() const { return string_view(base ? base : "", length); }
+};
+
+// Number of lines in text, counting a final line without a newline
+size_t countLines(string_view text) {
+    size_t lines = 0;
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        lines++;
+        if (!nl) break;
+        p = nl + 1;
+    }
+    return lines;
+}
+
+// Call fn(line, lineNumber) for every non-empty line, without the line ending
+template <typename LineFn>
+void forEachLine(string_view text, LineFn fn) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    size_t lineNumber = 0;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* lineEnd = nl ? nl : end;
+        size_t length = lineEnd - p;
+        if (length > 0 && p[length - 1] == '\r') length--;
+        lineNumber++;
+        if (length > 0) fn(string_view(p, length), lineNumber);
+        p = nl ? nl + 1 : end;
+    }
+}
+
+// Split line on commas into at most count fields; missing fields are empty
+template <size_t count>
+array<string_view, count> splitFields(string_view line) {
+    array<string_view, count> fields;
+    for (size_t i = 0; i < count; i++) {
+        size_t comma = (i + 1 < count) ? line.find(',') : string_view::npos;
+        fields[i] = line.substr(0, comma);
+        if (comma == string_view::npos) {
+            line = string_view();
         }
-        string line;
-        while (getline(file, line)) {
-            stringstream ss(line);
-            string accountNumber, balanceStr;
-            getline(ss, accountNumber, ',');
-            getline(ss, balanceStr, ',');
-            Account acc(accountNumber);
-            acc.deposit(stod(balanceStr));  // Could throw exception if the balance is invalid
-            accounts.push_back(acc);
+        else {
+            line.remove_prefix(comma + 1);
         }
-        file.close();
     }
+    return fields;
+}
 
-    void loadTransactions() {
-        ifstream file("transactions.txt");
-        if (!file.is_open()) {
-            throw runtime_error("Unable to open transactions file.");
+Money parseAmount(string_view text, const char* file, size_t lineNumber) {
+    Money value;
+    if (!Money::parse(text, value)) {
+        throw runtime_error("Invalid amount '" + string(text) + "' in " + file + " line " + to_string(lineNumber) + ".");
+    }
+    return value;
+}
+
+int64_t parseTimestampField(string_view text, const char* file, size_t lineNumber) {
+    int64_t micros;
+    if (!parseTimestamp(text, micros)) {
+        throw runtime_error("Invalid date '" + string(text) + "' in " + file + " line " + to_string(lineNumber) + ".");
+    }
+    return micros;
+}
+
+// ---------- Write-ahead log ----------
+
+// CRC-32 (IEEE) used to detect torn or corrupted log frames
+uint32_t crc32(const char* data, size_t length) {
+    static const auto table = [] {
+        vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
         }
-        string line;
-        while (getline(file, line)) {
-            stringstream ss(line);
-            string transactionId, fromAccount, toAccount, amountStr, date;
-            getline(ss, transactionId, ',');
-            getline(ss, fromAccount, ',');
-            getline(ss, toAccount, ',');
-            getline(ss, amountStr, ',');
-            getline(ss, date, ',');
-            Transaction transaction(transactionId, fromAccount, toAccount, stod(amountStr), date);
-            transactions.push_back(transaction);
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// One atomic unit of change: every record in a batch is committed in a
+// single checksummed log frame, so a transfer's two balances and its
+// transaction are recovered together or not at all.
+// Records are absolute (full customer, full balance), so replaying one twice is harmless.
+class LogBatch {
+public:
+    // Types 2 and 3 stored amounts as doubles and types 3 and 5 stored the
+    // date as text; they are still replayed from older logs
+    enum RecordType : uint8_t {
+        PUT_CUSTOMER = 1, PUT_ACCOUNT_DOUBLE = 2, ADD_TRANSACTION_DOUBLE = 3, PUT_ACCOUNT = 4, ADD_TRANSACTION_DATE = 5,
+        ADD_TRANSACTION = 6
+    };
+
+    string bytes;
+
+    void putCustomer(const Customer& customer) {
+        putU8(PUT_CUSTOMER);
+        putString(customer.id);
+        putString(customer.name);
+        putString(customer.password);
+    }
+
+    void putAccount(const Account& account) {
+        putU8(PUT_ACCOUNT);
+        putString(account.getAccountNumber());
+        putI64(account.getBalance().toUnits());
+    }
+
+    void addTransaction(const Transaction& transaction) {
+        putU8(ADD_TRANSACTION);
+        putString(transaction.getTransactionId());
+        putString(transaction.getFromAccount());
+        putString(transaction.getToAccount());
+        putI64(transaction.getAmount().toUnits());
+        putI64(transaction.getTimestamp());
+    }
+
+private:
+    void putU8(uint8_t v) { bytes.push_back(static_cast<char>(v)); }
+
+    void putString(const string& v) {
+        uint16_t length = static_cast<uint16_t>(min<size_t>(v.size(), UINT16_MAX));
+        bytes.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        bytes.append(v, 0, length);
+    }
+
+    void putI64(int64_t v) { bytes.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+};
+
+// Cursor over the records of one LogBatch payload during recovery
+class LogReader {
+private:
+    const char* pos;
+    const char* end;
+
+    void need(size_t n) {
+        if (static_cast<size_t>(end - pos) < n) throw runtime_error("Truncated log record.");
+    }
+
+public:
+    LogReader(const char* data, size_t length) : pos(data), end(data + length) {}
+
+    bool done() const { return pos == end; }
+
+    uint8_t u8() {
+        need(1);
+        return static_cast<uint8_t>(*pos++);
+    }
+
+    string str() {
+        uint16_t length;
+        need(sizeof(length));
+        memcpy(&length, pos, sizeof(length));
+        pos += sizeof(length);
+        need(length);
+        string v(pos, length);
+        pos += length;
+        return v;
+    }
+
+    int64_t i64() {
+        int64_t v;
+        need(sizeof(v));
+        memcpy(&v, pos, sizeof(v));
+        pos += sizeof(v);
+        return v;
+    }
+
+    double f64() {
+        double v;
+        need(sizeof(v));
+        memcpy(&v, pos, sizeof(v));
+        pos += sizeof(v);
+        return v;
+    }
+};
+
+// Append-only binary log with group commit. Each frame is
+//   [magic u32][payload length u32][crc32 of payload u32][lsn u64][payload]
+// Writers queue their frame and wait; a single committer thread writes
+// everything queued so far with one write() and one fsync, then wakes all
+// the writers it made durable. Recovery stops at the first bad frame and
+// truncates the torn tail.
+class WriteAheadLog {
+private:
+    static const uint32_t FRAME_MAGIC = 0x4C41574Bu; // "KWAL"
+    static const size_t HEADER_SIZE = 4 + 4 + 4 + 8;
+
+    int fd = -1;
+    uint64_t nextLsn = 1;
+    uint64_t durableLsn = 0;
+    uint64_t fileBytes = 0;  // Bytes durably in the log file
+    string pending;          // Frames queued for the next group commit
+    uint64_t pendingLsn = 0; // Highest LSN in pending
+    bool stopping = false;
+    bool failed = false;
+    mutex lock;
+    condition_variable wakeCommitter;
+    condition_variable committed;
+    thread committer;
+
+    void commitLoop() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            wakeCommitter.wait(guard, [&] { return stopping || !pending.empty(); });
+            if (pending.empty() && stopping) return;
+
+            string batch;
+            batch.swap(pending);
+            uint64_t batchLsn = pendingLsn;
+            guard.unlock();
+            bool ok = writeAll(fd, batch.data(), batch.size()) && syncFile(fd);
+            guard.lock();
+
+            if (!ok) failed = true;
+            else fileBytes += batch.size();
+            durableLsn = batchLsn;
+            committed.notify_all();
         }
-        file.close();
     }
 
-    void saveCustomer(const Customer& customer) {
+public:
+    WriteAheadLog() = default;
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog() {
+        close();
+    }
+
+    // Open (or create) the log, hand every intact batch payload to apply in
+    // LSN order, drop any torn tail and start the committer thread. New
+    // batches get LSNs above both the log's last frame and firstLsn - 1.
+    // If anything fails the file is closed again, so commit() refuses to
+    // run instead of waiting for a committer that never started.
+    template <typename ApplyFn>
+    void open(const string& path, uint64_t firstLsn, ApplyFn apply) {
+        int file = openFile(path, O_RDWR | O_CREAT);
+        if (file < 0) throw runtime_error("Unable to open write-ahead log '" + path + "'.");
         try {
-            ofstream file("customers.txt", ios::app);
-            if (!file.is_open()) {
-                throw runtime_error("Unable to open customers file for saving.");
+            string contents;
+            char buffer[1 << 16];
+            while (true) {
+#ifdef _WIN32
+                int n = _read(file, buffer, sizeof(buffer));
+#else
+                ssize_t n = ::read(file, buffer, sizeof(buffer));
+#endif
+                if (n < 0) throw runtime_error("Unable to read write-ahead log '" + path + "'.");
+                if (n == 0) break;
+                contents.append(buffer, static_cast<size_t>(n));
+            }
+
+            size_t offset = 0;
+            while (contents.size() - offset >= HEADER_SIZE) {
+                uint32_t magic, length, crc;
+                uint64_t lsn;
+                const char* header = contents.data() + offset;
+                memcpy(&magic, header, 4);
+                memcpy(&length, header + 4, 4);
+                memcpy(&crc, header + 8, 4);
+                memcpy(&lsn, header + 12, 8);
+                if (magic != FRAME_MAGIC || contents.size() - offset - HEADER_SIZE < length) break;
+                const char* payload = header + HEADER_SIZE;
+                if (crc32(payload, length) != crc) break;
+                apply(lsn, payload, static_cast<size_t>(length));
+                nextLsn = lsn + 1;
+                offset += HEADER_SIZE + length;
+            }
+            nextLsn = max(nextLsn, firstLsn);
+            durableLsn = nextLsn - 1;
+            fileBytes = offset;
+
+            if (offset != contents.size()) {
+                cout << LIGHT_YELLOW << "Discarding " << contents.size() - offset
+                    << " bytes of incomplete log tail from '" << path << "'." << RESET << endl;
+#ifdef _WIN32
+                bool ok = _chsize_s(file, static_cast<long long>(offset)) == 0 && _lseeki64(file, 0, SEEK_END) >= 0;
+#else
+                bool ok = ftruncate(file, static_cast<off_t>(offset)) == 0 && lseek(file, 0, SEEK_END) >= 0;
+#endif
+                if (!ok) throw runtime_error("Unable to truncate write-ahead log '" + path + "'.");
             }
-            file << customer.toString();
-            file.close();
+
+            // The committer only touches fd once a commit has queued a batch
+            committer = thread(&WriteAheadLog::commitLoop, this);
         }
-        catch (const exception& e) {
-            cout << LIGHT_RED << "Error saving customer: " << e.what() << RESET << endl;
+        catch (...) {
+            closeFile(file);
+            throw;
         }
+        lock_guard<mutex> guard(lock);
+        fd = file;
     }
 
-    void saveAccount(const Account& account) {
-        try {
-            ofstream file("accounts.txt", ios::app);
-            if (!file.is_open()) {
-                throw runtime_error("Unable to open accounts file for saving.");
-            }
-            file << account.toString();
-            file.close();
+    // Append a batch and block until it is durable; returns its LSN
+    uint64_t commit(const LogBatch& batch) {
+        unique_lock<mutex> guard(lock);
+        if (fd < 0) throw runtime_error("Write-ahead log is not open.");
+        uint64_t lsn = nextLsn++;
+        uint32_t magic = FRAME_MAGIC;
+        uint32_t length = static_cast<uint32_t>(batch.bytes.size());
+        uint32_t crc = crc32(batch.bytes.data(), batch.bytes.size());
+        pending.append(reinterpret_cast<const char*>(&magic), 4);
+        pending.append(reinterpret_cast<const char*>(&length), 4);
+        pending.append(reinterpret_cast<const char*>(&crc), 4);
+        pending.append(reinterpret_cast<const char*>(&lsn), 8);
+        pending.append(batch.bytes);
+        pendingLsn = lsn;
+        wakeCommitter.notify_one();
+        committed.wait(guard, [&] { return durableLsn >= lsn; });
+        if (failed) throw runtime_error("Write-ahead log write failed; changes may not be durable.");
+        return lsn;
+    }
+
+    void close() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
         }
-        catch (const exception& e) {
-            cout << LIGHT_RED << "Error saving account: " << e.what() << RESET << endl;
+        wakeCommitter.notify_one();
+        if (committer.joinable()) committer.join();
+        if (fd >= 0) {
+            closeFile(fd);
+            fd = -1;
         }
     }
 
-    void saveTransaction(const Transaction& transaction) {
-        try {
-            ofstream file("transactions.txt", ios::app);
-            if (!file.is_open()) {
-                throw runtime_error("Unable to open transactions file for saving.");
+    // LSN of the last committed batch
+    uint64_t lastLsn() {
+        lock_guard<mutex> guard(lock);
+        return nextLsn - 1;
+    }
+
+    uint64_t sizeBytes() {
+        lock_guard<mutex> guard(lock);
+        return fileBytes;
+    }
+
+    // Drop every frame after a snapshot has made them redundant. The caller
+    // must ensure no commit is in flight. LSNs keep counting up.
+    void truncate() {
+        lock_guard<mutex> guard(lock);
+        if (fd < 0) return;
+#ifdef _WIN32
+        bool ok = _chsize_s(fd, 0) == 0 && _lseeki64(fd, 0, SEEK_SET) == 0;
+#else
+        bool ok = ftruncate(fd, 0) == 0 && lseek(fd, 0, SEEK_SET) == 0;
+#endif
+        if (!ok || !syncFile(fd)) throw runtime_error("Unable to truncate write-ahead log.");
+        fileBytes = 0;
+    }
+};
+
+// Open-addressing hash index from a string key to a slot in one of the
+// BankingSystem tables. Linear probing over a power-of-two table, grown
+// before it passes 70% load.
+class HashIndex {
+private:
+    static const uint32_t EMPTY = UINT32_MAX;
+
+    struct Entry {
+        string key;
+        uint32_t slot = EMPTY;
+    };
+
+    vector<Entry> table;
+    size_t count = 0;
+
+    static uint64_t hashKey(const string& key) {
+        uint64_t h = 14695981039346656037ull; // FNV-1a
+        for (unsigned char ch : key) {
+            h ^= ch;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    size_t probe(const string& key) const {
+        size_t mask = table.size() - 1;
+        size_t i = hashKey(key) & mask;
+        while (table[i].slot != EMPTY && table[i].key != key) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    void grow() {
+        vector<Entry> old;
+        old.swap(table);
+        table.resize(old.empty() ? 16 : old.size() * 2);
+        for (auto& e : old) {
+            if (e.slot != EMPTY) {
+                Entry& target = table[probe(e.key)];
+                target.key = move(e.key);
+                target.slot = e.slot;
             }
-            file << transaction.toString();
-            file.close();
         }
-        catch (const exception& e) {
-            cout << LIGHT_RED << "Error saving transaction: " << e.what() << RESET << endl;
+    }
+
+public:
+    size_t size() const { return count; }
+
+    void reserve(size_t n) {
+        while (table.size() * 7 < n * 10) grow();
+    }
+
+    // Insert or overwrite the slot for key
+    void put(const string& key, uint32_t slot) {
+        if ((count + 1) * 10 > table.size() * 7) grow();
+        Entry& e = table[probe(key)];
+        if (e.slot == EMPTY) {
+            e.key = key;
+            count++;
         }
+        e.slot = slot;
     }
 
-    Customer* findCustomerById(const string& id) {
-        auto it = find_if(customers.begin(), customers.end(), [&](const Customer& customer) {
-            return customer.id == id;
-            });
-        return (it != customers.end()) ? &(*it) : nullptr;
+    // Slot for key, or -1 if absent
+    long long find(const string& key) const {
+        if (table.empty()) return -1;
+        const Entry& e = table[probe(key)];
+        return e.slot == EMPTY ? -1 : static_cast<long long>(e.slot);
+    }
+
+    // Remove key, shifting later entries of its probe run back so no
+    // tombstone is needed
+    void erase(const string& key) {
+        if (table.empty()) return;
+        size_t mask = table.size() - 1;
+        size_t hole = probe(key);
+        if (table[hole].slot == EMPTY) return;
+        for (size_t i = (hole + 1) & mask; table[i].slot != EMPTY; i = (i + 1) & mask) {
+            size_t home = hashKey(table[i].key) & mask;
+            // Entries whose home lies cyclically in (hole, i] must stay put
+            bool stays = hole <= i ? (home > hole && home <= i) : (home > hole || home <= i);
+            if (stays) continue;
+            table[hole] = move(table[i]);
+            hole = i;
+        }
+        table[hole].key.clear();
+        table[hole].slot = EMPTY;
+        count--;
+    }
+};
+
+// ---------- Metrics and tracing ----------
+
+// Engine operations with their own counters and latency histograms
+enum class Operation { Lookup, Authenticate, Register, Deposit, Withdraw, Transfer, Persist, Snapshot };
+const size_t OPERATION_COUNT = static_cast<size_t>(Operation::Snapshot) + 1;
+const char* const OPERATION_NAMES[OPERATION_COUNT] = {
+    "lookup", "authenticate", "register", "deposit", "withdraw", "transfer", "persist", "snapshot"
+};
+
+// Log-linear latency histogram in the style of HdrHistogram: nanosecond
+// values fall into power-of-two ranges that are each split into SUB_BUCKETS
+// linear steps, so a bucket is never wider than 1/16 of its values. Only the
+// owning thread writes; readers may sum it at any time, hence the relaxed
+// atomics (plain loads and stores on x86).
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static const size_t RANGES = 41;  // Up to about 2^44 ns (4.9 hours); longer values share the last bucket
+    static const size_t BUCKETS = RANGES * SUB_BUCKETS;
+
+    array<atomic<uint64_t>, BUCKETS> counts{};
+    atomic<uint64_t> total{ 0 };
+    atomic<uint64_t> sumNanos{ 0 };
+
+    static size_t bucketFor(uint64_t nanos) {
+        if (nanos < SUB_BUCKETS) return static_cast<size_t>(nanos);
+        int msb = 63 - __builtin_clzll(nanos);
+        size_t range = static_cast<size_t>(msb - SUB_BUCKET_BITS + 1);
+        size_t sub = static_cast<size_t>(nanos >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return min(range * SUB_BUCKETS + sub, BUCKETS - 1);
+    }
+
+    // Smallest value that falls above bucket index
+    static uint64_t upperBound(size_t index) {
+        size_t range = index / SUB_BUCKETS, sub = index % SUB_BUCKETS;
+        if (range == 0) return sub + 1;
+        return (SUB_BUCKETS + sub + 1) << (range - 1);
+    }
+
+    void record(uint64_t nanos) {
+        bump(counts[bucketFor(nanos)], 1);
+        bump(total, 1);
+        bump(sumNanos, nanos);
+    }
+
+    static void bump(atomic<uint64_t>& counter, uint64_t delta) {
+        counter.store(counter.load(memory_order_relaxed) + delta, memory_order_relaxed);
+    }
+};
+
+// Process-wide metrics. Each thread records into its own shard (taken from
+// a free list on first use and handed back when the thread exits), so the
+// hot path never shares a cache line or takes a lock; dumps sum the shards.
+// Trace spans are rare (file I/O) and go through one mutex.
+class BankMetrics {
+private:
+    struct Shard {
+        array<LatencyHistogram, OPERATION_COUNT> latency;
+        array<atomic<uint64_t>, OPERATION_COUNT> errors{};
+    };
+
+    struct SpanTotals {
+        uint64_t count = 0;
+        uint64_t sumNanos = 0;
+        uint64_t lastNanos = 0;
+    };
+
+    struct ShardHandle {
+        BankMetrics* owner = nullptr;
+        Shard* shard = nullptr;
+        ~ShardHandle() {
+            if (shard) owner->release(shard);
+        }
+    };
+
+    mutex lock;
+    deque<unique_ptr<Shard>> shards;
+    vector<Shard*> freeShards;
+    map<string, SpanTotals> spans;
+    bool traceToStderr = getenv("BANK_TRACE") != nullptr;
+
+    Shard& localShard() {
+        thread_local ShardHandle handle;
+        if (!handle.shard) {
+            lock_guard<mutex> guard(lock);
+            if (freeShards.empty()) {
+                shards.push_back(make_unique<Shard>());
+                handle.shard = shards.back().get();
+            }
+            else {
+                handle.shard = freeShards.back();
+                freeShards.pop_back();
+            }
+            handle.owner = this;
+        }
+        return *handle.shard;
+    }
+
+    void release(Shard* shard) {
+        lock_guard<mutex> guard(lock);
+        freeShards.push_back(shard);
+    }
+
+    // Quantile of a merged histogram, as the upper bound of its bucket
+    static double quantileSeconds(const vector<uint64_t>& counts, uint64_t total, double q) {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * total + 0.5);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= max<uint64_t>(rank, 1)) return LatencyHistogram::upperBound(i) / 1e9;
+        }
+        return LatencyHistogram::upperBound(counts.size() - 1) / 1e9;
+    }
+
+public:
+    void record(Operation operation, uint64_t nanos, bool ok) {
+        Shard& shard = localShard();
+        shard.latency[static_cast<size_t>(operation)].record(nanos);
+        if (!ok) LatencyHistogram::bump(shard.errors[static_cast<size_t>(operation)], 1);
+    }
+
+    void recordSpan(const string& name, uint64_t nanos, int depth) {
+        {
+            lock_guard<mutex> guard(lock);
+            SpanTotals& totals = spans[name];
+            totals.count++;
+            totals.sumNanos += nanos;
+            totals.lastNanos = nanos;
+        }
+        if (traceToStderr) {
+            cerr << "trace: " << string(depth * 2, ' ') << name << " " << fixed << setprecision(3)
+                << nanos / 1e6 << " ms" << endl;
+        }
+    }
+
+    // Prometheus text exposition format
+    void writePrometheus(ostream& out) {
+        static const double BOUNDS[] = { 1e-6, 5e-6, 1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 5e-3, 1e-2, 5e-2, 0.1, 0.5, 1, 5, 10 };
+        lock_guard<mutex> guard(lock);
+
+        out << "# HELP bank_operations_total Engine operations by outcome.\n"
+            << "# TYPE bank_operations_total counter\n";
+        vector<vector<uint64_t>> merged(OPERATION_COUNT, vector<uint64_t>(LatencyHistogram::BUCKETS));
+        vector<uint64_t> totals(OPERATION_COUNT), errors(OPERATION_COUNT), sums(OPERATION_COUNT);
+        for (const auto& shard : shards) {
+            for (size_t op = 0; op < OPERATION_COUNT; op++) {
+                const LatencyHistogram& h = shard->latency[op];
+                for (size_t i = 0; i < LatencyHistogram::BUCKETS; i++) merged[op][i] += h.counts[i].load(memory_order_relaxed);
+                totals[op] += h.total.load(memory_order_relaxed);
+                sums[op] += h.sumNanos.load(memory_order_relaxed);
+                errors[op] += shard->errors[op].load(memory_order_relaxed);
+            }
+        }
+        for (size_t op = 0; op < OPERATION_COUNT; op++) {
+            out << "bank_operations_total{operation=\"" << OPERATION_NAMES[op] << "\",outcome=\"ok\"} "
+                << totals[op] - min(errors[op], totals[op]) << "\n";
+            out << "bank_operations_total{operation=\"" << OPERATION_NAMES[op] << "\",outcome=\"error\"} "
+                << errors[op] << "\n";
+        }
+
+        out << "# HELP bank_operation_duration_seconds Engine operation latency.\n"
+            << "# TYPE bank_operation_duration_seconds histogram\n";
+        for (size_t op = 0; op < OPERATION_COUNT; op++) {
+            size_t bucket = 0;
+            uint64_t cumulative = 0;
+            for (double bound : BOUNDS) {
+                while (bucket < LatencyHistogram::BUCKETS && LatencyHistogram::upperBound(bucket) <= bound * 1e9) {
+                    cumulative += merged[op][bucket++];
+                }
+                out << "bank_operation_duration_seconds_bucket{operation=\"" << OPERATION_NAMES[op]
+                    << "\",le=\"" << bound << "\"} " << cumulative << "\n";
+            }
+            out << "bank_operation_duration_seconds_bucket{operation=\"" << OPERATION_NAMES[op]
+                << "\",le=\"+Inf\"} " << totals[op] << "\n";
+            out << "bank_operation_duration_seconds_sum{operation=\"" << OPERATION_NAMES[op] << "\"} "
+                << sums[op] / 1e9 << "\n";
+            out << "bank_operation_duration_seconds_count{operation=\"" << OPERATION_NAMES[op] << "\"} "
+                << totals[op] << "\n";
+        }
+
+        out << "# HELP bank_operation_latency_seconds Engine operation latency quantiles from the full-resolution histogram.\n"
+            << "# TYPE bank_operation_latency_seconds gauge\n";
+        for (size_t op = 0; op < OPERATION_COUNT; op++) {
+            for (double q : { 0.5, 0.99, 0.999 }) {
+                out << "bank_operation_latency_seconds{operation=\"" << OPERATION_NAMES[op] << "\",quantile=\""
+                    << q << "\"} " << quantileSeconds(merged[op], totals[op], q) << "\n";
+            }
+        }
+
+        out << "# HELP bank_span_duration_seconds Time spent in traced file I/O.\n"
+            << "# TYPE bank_span_duration_seconds summary\n";
+        for (const auto& span : spans) {
+            out << "bank_span_duration_seconds_sum{span=\"" << span.first << "\"} " << span.second.sumNanos / 1e9 << "\n";
+            out << "bank_span_duration_seconds_count{span=\"" << span.first << "\"} " << span.second.count << "\n";
+        }
+        out << "# HELP bank_span_last_duration_seconds Duration of the latest run of each traced span.\n"
+            << "# TYPE bank_span_last_duration_seconds gauge\n";
+        for (const auto& span : spans) {
+            out << "bank_span_last_duration_seconds{span=\"" << span.first << "\"} " << span.second.lastNanos / 1e9 << "\n";
+        }
+    }
+
+    // Write the metrics to path ("-" for stdout); false if the file cannot be written
+    bool dump(const string& path) {
+        stringstream text;
+        writePrometheus(text);
+        if (path == "-") {
+            cout << text.str() << flush;
+            return true;
+        }
+        try {
+            writeFileAtomically(path, text.str());
+            return true;
+        }
+        catch (const exception&) {
+            return false;
+        }
+    }
+};
+
+BankMetrics bankMetrics;
+
+// Times a block of file I/O and records it under name; spans nest per thread
+class TraceSpan {
+private:
+    string name;
+    chrono::steady_clock::time_point start;
+    int depth;
+
+    static int& currentDepth() {
+        thread_local int depth = 0;
+        return depth;
+    }
+
+public:
+    explicit TraceSpan(string name) : name(move(name)), start(chrono::steady_clock::now()), depth(currentDepth()++) {}
+
+    ~TraceSpan() {
+        currentDepth()--;
+        auto nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        bankMetrics.recordSpan(name, static_cast<uint64_t>(nanos), depth);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+// ---------- Columnar ledger ----------
+
+// Read-only binary copy of the ledger for reporting, one array per column:
+//   [magic u32][version u32][row count u64][account count u64]
+//   [account dictionary: count x (length u16, bytes)][zero padding to 8 bytes]
+//   [id u64 x rows][timestamp i64 x rows][amount i64 x rows]
+//   [from u32 x rows][to u32 x rows]
+// Account numbers are dictionary-encoded as u32 codes. Scans are plain
+// loops over the columns that the compiler can vectorise, except the
+// per-account totals, which scatter; sums are kept in raw cents.
+class ColumnarLedger {
+private:
+    static const uint32_t MAGIC = 0x4C434C4Bu;  // "KLCL"
+    static const uint32_t VERSION = 1;
+    static const int64_t MICROS_PER_DAY = 86400LL * 1000000;
+
+    HashIndex accountCodes;
+
+    template <typename T>
+    static void appendColumn(string& out, const vector<T>& column) {
+        out.append(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+    }
+
+    template <typename T>
+    static bool readColumn(string_view data, size_t& offset, size_t rows, vector<T>& column) {
+        if (data.size() - offset < rows * sizeof(T)) return false;
+        column.resize(rows);
+        if (rows > 0) memcpy(column.data(), data.data() + offset, rows * sizeof(T));
+        offset += rows * sizeof(T);
+        return true;
+    }
+
+public:
+    vector<string> accounts;     // Dictionary: code -> account number
+    vector<uint64_t> ids;
+    vector<int64_t> timestamps;  // Microseconds since the Unix epoch
+    vector<int64_t> amounts;     // Cents
+    vector<uint32_t> from;
+    vector<uint32_t> to;
+
+    struct AccountTotals {
+        Money sent;
+        Money received;
+        uint64_t sentCount = 0;
+        uint64_t receivedCount = 0;
+    };
+
+    size_t size() const { return amounts.size(); }
+
+    uint32_t encode(const string& accountNumber) {
+        long long code = accountCodes.find(accountNumber);
+        if (code >= 0) return static_cast<uint32_t>(code);
+        accounts.push_back(accountNumber);
+        accountCodes.put(accountNumber, static_cast<uint32_t>(accounts.size() - 1));
+        return static_cast<uint32_t>(accounts.size() - 1);
+    }
+
+    // Code of an account number, or -1 if it never appears
+    long long find(const string& accountNumber) const {
+        return accountCodes.find(accountNumber);
+    }
+
+    void append(const string& id, const string& fromAccount, const string& toAccount, Money amount, int64_t timestamp) {
+        uint64_t numericId = 0;
+        from_chars(id.data(), id.data() + id.size(), numericId);
+        ids.push_back(numericId);
+        timestamps.push_back(timestamp);
+        amounts.push_back(amount.toUnits());
+        from.push_back(encode(fromAccount));
+        to.push_back(encode(toAccount));
+    }
+
+    // Build from a transactions.txt-format file
+    void loadText(const string& path) {
+        MappedFile file(path);
+        string_view text = file.view();
+        size_t rows = countLines(text);
+        ids.reserve(rows);
+        timestamps.reserve(rows);
+        amounts.reserve(rows);
+        from.reserve(rows);
+        to.reserve(rows);
+        forEachLine(text, [&](string_view line, size_t lineNumber) {
+            auto f = splitFields<5>(line);
+            append(string(f[0]), string(f[1]), string(f[2]), parseAmount(f[3], path.c_str(), lineNumber),
+                parseTimestampField(f[4], path.c_str(), lineNumber));
+        });
+    }
+
+    void save(const string& path) const {
+        string out;
+        uint32_t magic = MAGIC, version = VERSION;
+        uint64_t rows = size(), count = accounts.size();
+        out.append(reinterpret_cast<const char*>(&magic), 4);
+        out.append(reinterpret_cast<const char*>(&version), 4);
+        out.append(reinterpret_cast<const char*>(&rows), 8);
+        out.append(reinterpret_cast<const char*>(&count), 8);
+        for (const auto& account : accounts) {
+            uint16_t length = static_cast<uint16_t>(min<size_t>(account.size(), UINT16_MAX));
+            out.append(reinterpret_cast<const char*>(&length), 2);
+            out.append(account, 0, length);
+        }
+        out.resize((out.size() + 7) & ~size_t(7), '\0');
+        appendColumn(out, ids);
+        appendColumn(out, timestamps);
+        appendColumn(out, amounts);
+        appendColumn(out, from);
+        appendColumn(out, to);
+        writeFileAtomically(path, out);
+    }
+
+    // Load a file written by save(); false if it is missing or malformed
+    bool load(const string& path) {
+        MappedFile file(path);
+        string_view data = file.view();
+        uint32_t magic = 0, version = 0;
+        uint64_t rows = 0, count = 0;
+        if (data.size() < 24) return false;
+        memcpy(&magic, data.data(), 4);
+        memcpy(&version, data.data() + 4, 4);
+        memcpy(&rows, data.data() + 8, 8);
+        memcpy(&count, data.data() + 16, 8);
+        if (magic != MAGIC || version != VERSION) return false;
+
+        size_t offset = 24;
+        accounts.clear();
+        accountCodes = HashIndex();
+        accountCodes.reserve(count);
+        for (uint64_t i = 0; i < count; i++) {
+            uint16_t length;
+            if (data.size() - offset < 2) return false;
+            memcpy(&length, data.data() + offset, 2);
+            if (data.size() - offset - 2 < length) return false;
+            encode(string(data.substr(offset + 2, length)));
+            offset += 2 + length;
+        }
+        offset = (offset + 7) & ~size_t(7);
+        if (offset > data.size()) return false;
+        if (!readColumn(data, offset, rows, ids) || !readColumn(data, offset, rows, timestamps)
+            || !readColumn(data, offset, rows, amounts) || !readColumn(data, offset, rows, from)
+            || !readColumn(data, offset, rows, to)) {
+            return false;
+        }
+        for (size_t i = 0; i < rows; i++) {
+            if (from[i] >= count || to[i] >= count) return false;
+        }
+        return true;
+    }
+
+    // Sent and received totals for every account, indexed by code. This is
+    // a scatter into per-account sums, which stays scalar: AVX2 has no
+    // scatter, and lane-private copies of the sums were slower on large
+    // dictionaries. Each account's sum and count share a cache line instead,
+    // so a row costs one miss per side rather than two.
+    vector<AccountTotals> accountTotals() const {
+        struct Sum {
+            int64_t cents = 0;
+            uint64_t count = 0;
+        };
+        size_t rows = size();
+        vector<Sum> sent(accounts.size()), received(accounts.size());
+        const int64_t* amount = amounts.data();
+        const uint32_t* source = from.data();
+        const uint32_t* target = to.data();
+        for (size_t i = 0; i < rows; i++) {
+            Sum& sum = sent[source[i]];
+            sum.cents += amount[i];
+            sum.count++;
+        }
+        for (size_t i = 0; i < rows; i++) {
+            Sum& sum = received[target[i]];
+            sum.cents += amount[i];
+            sum.count++;
+        }
+
+        vector<AccountTotals> totals(accounts.size());
+        for (size_t code = 0; code < accounts.size(); code++) {
+            totals[code].sent = Money::fromUnits(sent[code].cents);
+            totals[code].received = Money::fromUnits(received[code].cents);
+            totals[code].sentCount = sent[code].count;
+            totals[code].receivedCount = received[code].count;
+        }
+        return totals;
+    }
+
+    // Total amount moved per UTC day (days since the Unix epoch), in day order.
+    // The ledger is appended in time order, so each day is a contiguous run
+    // that is summed with a straight reduction over the amount column.
+    vector<pair<int64_t, Money>> dailyVolume() const {
+        map<int64_t, int64_t> volume;
+        size_t rows = size(), i = 0;
+        const int64_t* amount = amounts.data();
+        while (i < rows) {
+            int64_t day = timestamps[i] / MICROS_PER_DAY - (timestamps[i] % MICROS_PER_DAY < 0 ? 1 : 0);
+            int64_t dayStart = day * MICROS_PER_DAY, dayEnd = dayStart + MICROS_PER_DAY;
+            size_t end = i + 1;
+            while (end < rows && timestamps[end] >= dayStart && timestamps[end] < dayEnd) end++;
+            int64_t sum = 0;
+            for (size_t k = i; k < end; k++) sum += amount[k];
+            volume[day] += sum;
+            i = end;
+        }
+
+        vector<pair<int64_t, Money>> result;
+        for (const auto& entry : volume) result.emplace_back(entry.first, Money::fromUnits(entry.second));
+        return result;
+    }
+
+    // The n accounts that moved the most money to or from account, largest first
+    vector<pair<uint32_t, Money>> topCounterparties(uint32_t account, size_t n) const {
+        size_t rows = size();
+        vector<int64_t> volume(accounts.size());
+        const int64_t* amount = amounts.data();
+        const uint32_t* source = from.data();
+        const uint32_t* target = to.data();
+        for (size_t i = 0; i < rows; i++) {
+            // Branch-free: rows not involving account add zero to slot 0
+            int64_t outgoing = source[i] == account ? amount[i] : 0;
+            int64_t incoming = target[i] == account ? amount[i] : 0;
+            volume[outgoing ? target[i] : 0] += outgoing;
+            volume[incoming ? source[i] : 0] += incoming;
+        }
+        volume[account] = 0;
+
+        vector<pair<uint32_t, Money>> result;
+        for (size_t code = 0; code < volume.size(); code++) {
+            if (volume[code] > 0) result.emplace_back(static_cast<uint32_t>(code), Money::fromUnits(volume[code]));
+        }
+        size_t keep = min(n, result.size());
+        partial_sort(result.begin(), result.begin() + keep, result.end(),
+            [](const pair<uint32_t, Money>& a, const pair<uint32_t, Money>& b) { return a.second > b.second; });
+        result.resize(keep);
+        return result;
+    }
+};
+
+// ---------- Password hashing ----------
+// Customer passwords are stored as
+//   pbkdf2-sha256$<iterations>$<salt hex>$<key hex>
+// (PBKDF2-HMAC-SHA256 from RFC 8018 with a 16-byte random salt and a 32-byte
+// key). Records written before hashing hold the plaintext; those still verify
+// and are rehashed on the customer's next successful login.
+
+const char* const PASSWORD_HASH_PREFIX = "pbkdf2-sha256$";
+const uint32_t DEFAULT_HASH_ITERATIONS = 20000;
+const size_t PASSWORD_SALT_BYTES = 16;
+
+class Sha256 {
+public:
+    static const size_t DIGEST_SIZE = 32;
+    static const size_t BLOCK_SIZE = 64;
+
+private:
+    static constexpr uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    uint8_t block[BLOCK_SIZE];
+    size_t used = 0;
+    uint64_t totalBytes = 0;
+
+    static uint32_t rotr(uint32_t x, int n) {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    static void compress(uint32_t* h, const uint8_t* data) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = uint32_t(data[i * 4]) << 24 | uint32_t(data[i * 4 + 1]) << 16 | uint32_t(data[i * 4 + 2]) << 8 | data[i * 4 + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            k = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+        h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+    }
+
+    static void storeDigest(const uint32_t* h, uint8_t* digest) {
+        for (int i = 0; i < 8; i++) {
+            digest[i * 4] = uint8_t(h[i] >> 24);
+            digest[i * 4 + 1] = uint8_t(h[i] >> 16);
+            digest[i * 4 + 2] = uint8_t(h[i] >> 8);
+            digest[i * 4 + 3] = uint8_t(h[i]);
+        }
+    }
+
+public:
+    void update(const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        totalBytes += length;
+        while (length > 0) {
+            if (used == 0 && length >= BLOCK_SIZE) {
+                compress(state, bytes);
+                bytes += BLOCK_SIZE;
+                length -= BLOCK_SIZE;
+                continue;
+            }
+            size_t take = min(length, BLOCK_SIZE - used);
+            memcpy(block + used, bytes, take);
+            used += take;
+            bytes += take;
+            length -= take;
+            if (used == BLOCK_SIZE) {
+                compress(state, block);
+                used = 0;
+            }
+        }
+    }
+
+    void finish(uint8_t* digest) {
+        uint64_t bits = totalBytes * 8;
+        uint8_t padding[BLOCK_SIZE + 8] = { 0x80 };
+        size_t padLength = (used < 56 ? 56 : 120) - used;
+        for (int i = 0; i < 8; i++) padding[padLength + i] = uint8_t(bits >> (56 - 8 * i));
+        update(padding, padLength + 8);
+        storeDigest(state, digest);
+    }
+
+    // Digest of the data so far followed by one last block that the caller
+    // has already padded; leaves this object unchanged. PBKDF2 rounds hash a
+    // fixed 32 bytes after a saved HMAC key block, so this is all they need.
+    void finishPadded(const uint8_t* lastBlock, uint8_t* digest) const {
+        uint32_t h[8];
+        memcpy(h, state, sizeof(h));
+        compress(h, lastBlock);
+        storeDigest(h, digest);
+    }
+};
+
+// PBKDF2-HMAC-SHA256 producing one 32-byte block
+array<uint8_t, Sha256::DIGEST_SIZE> pbkdf2Sha256(string_view password, string_view salt, uint32_t iterations) {
+    // HMAC key blocks; keys longer than a block are hashed first
+    uint8_t key[Sha256::BLOCK_SIZE] = {};
+    if (password.size() > Sha256::BLOCK_SIZE) {
+        Sha256 longKey;
+        longKey.update(password.data(), password.size());
+        longKey.finish(key);
+    }
+    else {
+        memcpy(key, password.data(), password.size());
+    }
+    uint8_t pad[Sha256::BLOCK_SIZE];
+    Sha256 inner, outer;
+    for (size_t i = 0; i < Sha256::BLOCK_SIZE; i++) pad[i] = key[i] ^ 0x36;
+    inner.update(pad, sizeof(pad));
+    for (size_t i = 0; i < Sha256::BLOCK_SIZE; i++) pad[i] = key[i] ^ 0x5c;
+    outer.update(pad, sizeof(pad));
+
+    // U1 = HMAC(password, salt || INT(1))
+    array<uint8_t, Sha256::DIGEST_SIZE> result;
+    uint8_t u[Sha256::DIGEST_SIZE];
+    const uint8_t blockIndex[4] = { 0, 0, 0, 1 };
+    Sha256 first = inner;
+    first.update(salt.data(), salt.size());
+    first.update(blockIndex, sizeof(blockIndex));
+    first.finish(u);
+    first = outer;
+    first.update(u, sizeof(u));
+    first.finish(u);
+    memcpy(result.data(), u, sizeof(u));
+
+    // Un = HMAC(password, Un-1): both hashes cover one key block plus 32
+    // bytes, so each is a single padded block on top of a saved state
+    uint8_t message[Sha256::BLOCK_SIZE] = {};
+    message[Sha256::DIGEST_SIZE] = 0x80;
+    message[Sha256::BLOCK_SIZE - 2] = 0x03;  // (64 + 32) * 8 = 768 bits
+    for (uint32_t round = 1; round < iterations; round++) {
+        memcpy(message, u, sizeof(u));
+        inner.finishPadded(message, u);
+        memcpy(message, u, sizeof(u));
+        outer.finishPadded(message, u);
+        for (size_t i = 0; i < sizeof(u); i++) result[i] ^= u[i];
+    }
+    return result;
+}
+
+string hexEncode(const uint8_t* bytes, size_t length) {
+    static const char DIGITS[] = "0123456789abcdef";
+    string hex(length * 2, '0');
+    for (size_t i = 0; i < length; i++) {
+        hex[i * 2] = DIGITS[bytes[i] >> 4];
+        hex[i * 2 + 1] = DIGITS[bytes[i] & 0xf];
+    }
+    return hex;
+}
+
+bool hexDecode(string_view hex, string& bytes) {
+    auto digit = [](char ch) {
+        if (ch >= '0' && ch <= '9') return ch - '0';
+        if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+        return -1;
+    };
+    if (hex.size() % 2 != 0) return false;
+    bytes.resize(hex.size() / 2);
+    for (size_t i = 0; i < bytes.size(); i++) {
+        int high = digit(hex[i * 2]), low = digit(hex[i * 2 + 1]);
+        if (high < 0 || low < 0) return false;
+        bytes[i] = static_cast<char>(high << 4 | low);
+    }
+    return true;
+}
+
+// Random bytes for salts and session tokens
+string randomBytes(size_t count) {
+    thread_local random_device device;
+    string bytes(count, '\0');
+    for (size_t i = 0; i < count; i += 4) {
+        uint32_t value = device();
+        memcpy(&bytes[i], &value, min<size_t>(4, count - i));
+    }
+    return bytes;
+}
+
+// Equality that looks at every byte whatever the first difference, so its
+// running time depends only on the lengths
+bool constantTimeEquals(string_view a, string_view b) {
+    unsigned char difference = a.size() != b.size();
+    size_t length = min(a.size(), b.size());
+    for (size_t i = 0; i < length; i++) difference |= a[i] ^ b[i];
+    return difference == 0;
+}
+
+bool isPasswordHash(string_view stored) {
+    return stored.substr(0, strlen(PASSWORD_HASH_PREFIX)) == PASSWORD_HASH_PREFIX;
+}
+
+string hashPassword(string_view password, uint32_t iterations) {
+    string salt = randomBytes(PASSWORD_SALT_BYTES);
+    auto key = pbkdf2Sha256(password, salt, iterations);
+    return PASSWORD_HASH_PREFIX + to_string(iterations) + "$"
+        + hexEncode(reinterpret_cast<const uint8_t*>(salt.data()), salt.size()) + "$"
+        + hexEncode(key.data(), key.size());
+}
+
+// True when password matches a stored credential, hashed or legacy plaintext
+bool verifyPassword(string_view stored, string_view password) {
+    if (!isPasswordHash(stored)) return constantTimeEquals(stored, password);
+
+    string_view fields = stored.substr(strlen(PASSWORD_HASH_PREFIX));
+    size_t saltStart = fields.find('$');
+    size_t keyStart = saltStart == string_view::npos ? saltStart : fields.find('$', saltStart + 1);
+    if (keyStart == string_view::npos) return false;
+    uint32_t iterations = 0;
+    string salt;
+    if (from_chars(fields.data(), fields.data() + saltStart, iterations).ec != errc() || iterations == 0
+        || !hexDecode(fields.substr(saltStart + 1, keyStart - saltStart - 1), salt)) {
+        return false;
+    }
+    auto key = pbkdf2Sha256(password, salt, iterations);
+    return constantTimeEquals(hexEncode(key.data(), key.size()), fields.substr(keyStart + 1));
+}
+
+// Runs password hashing on a fixed pool of worker threads, one per core by
+// default. Callers block until their job is done; at most four jobs per
+// worker wait in the queue and further callers wait for room, so a burst of
+// logins queues up instead of oversubscribing the CPU.
+class CredentialVerifier {
+private:
+    vector<thread> workers;
+    deque<function<void()>> queue;
+    size_t queueCapacity;
+    mutex queueLock;
+    condition_variable workReady;
+    condition_variable roomReady;
+    bool stopping = false;
+
+    void workerLoop() {
+        while (true) {
+            function<void()> job;
+            {
+                unique_lock<mutex> lock(queueLock);
+                workReady.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;
+                job = move(queue.front());
+                queue.pop_front();
+            }
+            roomReady.notify_one();
+            job();
+        }
+    }
+
+    // Run fn on a worker and wait for its result (or exception)
+    template <typename Result, typename Fn>
+    Result run(Fn fn) {
+        packaged_task<Result()> task(move(fn));
+        future<Result> result = task.get_future();
+        {
+            unique_lock<mutex> lock(queueLock);
+            roomReady.wait(lock, [this] { return queue.size() < queueCapacity; });
+            queue.emplace_back([&task] { task(); });
+        }
+        workReady.notify_one();
+        return result.get();
+    }
+
+public:
+    explicit CredentialVerifier(unsigned threadCount = max(1u, thread::hardware_concurrency()))
+        : queueCapacity(size_t(threadCount) * 4) {
+        for (unsigned i = 0; i < threadCount; i++) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~CredentialVerifier() {
+        {
+            lock_guard<mutex> lock(queueLock);
+            stopping = true;
+        }
+        workReady.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    CredentialVerifier(const CredentialVerifier&) = delete;
+    CredentialVerifier& operator=(const CredentialVerifier&) = delete;
+
+    unsigned threadCount() const {
+        return static_cast<unsigned>(workers.size());
+    }
+
+    string hash(const string& password, uint32_t iterations) {
+        return run<string>([&] { return hashPassword(password, iterations); });
+    }
+
+    bool verify(const string& stored, const string& password) {
+        return run<bool>([&] { return verifyPassword(stored, password); });
+    }
+};
+
+// Verified logins by random token, so a customer's later actions are checked
+// with one lookup instead of another password hash. A session lasts ttl from
+// login; past capacity the oldest sessions are dropped first.
+class SessionCache {
+private:
+    struct Session {
+        string customerId;
+        chrono::steady_clock::time_point expires;
+    };
+    unordered_map<string, Session> sessions;
+    deque<pair<string, chrono::steady_clock::time_point>> issued;  // Tokens by expiry, including ended ones
+    chrono::steady_clock::duration ttl;
+    size_t capacity;
+    mutex lock;
+
+    // Forget expired and ended sessions, and the oldest while over capacity
+    void evict(chrono::steady_clock::time_point now) {
+        while (!issued.empty()) {
+            auto it = sessions.find(issued.front().first);
+            bool ended = it == sessions.end();
+            if (!ended && issued.front().second > now && sessions.size() < capacity) break;
+            if (!ended) sessions.erase(it);
+            issued.pop_front();
+        }
+    }
+
+public:
+    static const size_t TOKEN_BYTES = 16;
+
+    explicit SessionCache(chrono::steady_clock::duration ttl = chrono::minutes(15), size_t capacity = 100000)
+        : ttl(ttl), capacity(max<size_t>(1, capacity)) {}
+
+    string issue(const string& customerId) {
+        string token = randomBytes(TOKEN_BYTES);
+        token = hexEncode(reinterpret_cast<const uint8_t*>(token.data()), token.size());
+        auto now = chrono::steady_clock::now();
+        lock_guard<mutex> guard(lock);
+        evict(now);
+        sessions[token] = Session{ customerId, now + ttl };
+        issued.emplace_back(token, now + ttl);
+        return token;
+    }
+
+    // The customer a live token belongs to
+    bool check(const string& token, string& customerId) {
+        auto now = chrono::steady_clock::now();
+        lock_guard<mutex> guard(lock);
+        auto it = sessions.find(token);
+        if (it == sessions.end()) return false;
+        if (it->second.expires <= now) {
+            sessions.erase(it);
+            return false;
+        }
+        customerId = it->second.customerId;
+        return true;
+    }
+
+    void revoke(const string& token) {
+        lock_guard<mutex> guard(lock);
+        sessions.erase(token);
+    }
+};
+
+// Outcome of a BankingSystem engine call
+enum class BankStatus {
+    Ok,
+    AccountNotFound,
+    InsufficientFunds,
+    InvalidAmount,
+    SameAccount,
+    NameTaken,
+    InvalidCredentials,
+    InvalidCursor,   // History cursor that does not belong to the account
+    SessionExpired,  // Unknown, ended or expired session token
+    StorageError,    // The change could not be made durable
+    UnknownCommand,  // Batch mode: unrecognised or malformed command line
+};
+
+// Short code for batch output
+const char* statusName(BankStatus status) {
+    switch (status) {
+    case BankStatus::Ok: return "OK";
+    case BankStatus::AccountNotFound: return "ACCOUNT_NOT_FOUND";
+    case BankStatus::InsufficientFunds: return "INSUFFICIENT_FUNDS";
+    case BankStatus::InvalidAmount: return "INVALID_AMOUNT";
+    case BankStatus::SameAccount: return "SAME_ACCOUNT";
+    case BankStatus::NameTaken: return "NAME_TAKEN";
+    case BankStatus::InvalidCredentials: return "INVALID_CREDENTIALS";
+    case BankStatus::InvalidCursor: return "INVALID_CURSOR";
+    case BankStatus::SessionExpired: return "SESSION_EXPIRED";
+    case BankStatus::StorageError: return "STORAGE_ERROR";
+    case BankStatus::UnknownCommand: return "UNKNOWN_COMMAND";
+    }
+    return "UNKNOWN";
+}
+
+// Message shown by the console front end
+const char* statusMessage(BankStatus status) {
+    switch (status) {
+    case BankStatus::Ok: return "Success.";
+    case BankStatus::AccountNotFound: return "Account not found!";
+    case BankStatus::InsufficientFunds: return "Insufficient funds.";
+    case BankStatus::InvalidAmount: return "Amount must be positive and keep the balance in range.";
+    case BankStatus::SameAccount: return "Cannot transfer to the same account.";
+    case BankStatus::NameTaken: return "A user with this name already exists! Please choose a different username.";
+    case BankStatus::InvalidCredentials: return "Invalid credentials!";
+    case BankStatus::InvalidCursor: return "That page of history is not available.";
+    case BankStatus::SessionExpired: return "Your session has expired. Please log in again.";
+    case BankStatus::StorageError: return "The change could not be saved.";
+    case BankStatus::UnknownCommand: return "Unknown command.";
+    }
+    return "Unknown error.";
+}
+
+const size_t BANK_STATUS_COUNT = static_cast<size_t>(BankStatus::UnknownCommand) + 1;
+
+class BankingSystem {
+private:
+    // deques never move existing elements on push_back, so the pointers
+    // returned by the find* methods stay valid as the tables grow
+    deque<Customer> customers;
+    deque<Account> accounts;
+    vector<Transaction> transactions;
+    HashIndex customerById;
+    HashIndex customerByName;
+    HashIndex accountByNumber;
+    Customer* currentCustomer = nullptr;
+    string currentSession;  // Session token of currentCustomer
+    WriteAheadLog wal;
+    bool durable = true;  // False keeps everything in memory (used by the stress test)
+    bool readOnly = false;  // The data files or the log failed to load: no commits, no snapshots
+
+    // Snapshot bookkeeping: customers.txt and accounts.txt hold one record per
+    // customer/account as of snapshotLsn, and transactions.txt holds the first
+    // ledgerRows transactions. Later changes live only in the log tail.
+    uint64_t snapshotLsn = 0;
+    size_t ledgerRows = 0;
+    uint64_t ledgerFileBytes = 0;  // Size of transactions.txt holding those rows
+    static const uint64_t SNAPSHOT_LOG_BYTES = 4 << 20;  // Compact once the log tail passes this size
+    atomic<uint64_t> snapshotAtBytes{ SNAPSHOT_LOG_BYTES };  // Pushed out by a failed snapshot
+
+    // Per-account history: every ledger row links to the previous row of its
+    // source and of its target account, and accountHead holds each account's
+    // newest row, so one account's transactions are walked newest first
+    // without touching anyone else's. Persisted as transactions.idx (one link
+    // per ledger row, appended in step with transactions.txt) and
+    // history.heads (rewritten by every snapshot).
+    struct HistoryLink {
+        uint32_t prevFrom;
+        uint32_t prevTo;
+    };
+    static const uint32_t NO_ROW = UINT32_MAX;
+    static const uint32_t HEADS_MAGIC = 0x53444848u; // "HHDS"
+    vector<HistoryLink> historyLinks;  // Parallel to transactions
+    deque<uint32_t> accountHead;       // Parallel to accounts
+    bool linksOnDisk = false;          // transactions.idx holds exactly ledgerRows links
+
+    // Locking: registryLock guards the tables and indexes. Account operations
+    // hold it shared plus the stripe lock of every account they touch, and
+    // keep those locks until their log batch is durable and applied, so each
+    // account's records reach the log in the order they take effect; memory
+    // changes only after the commit succeeds. Registration and
+    // snapshots hold registryLock exclusively. ledgerLock orders appends to
+    // transactions (and historyLinks) between concurrent transfers. An
+    // account's accountHead entry belongs to its stripe.
+    static const size_t LOCK_STRIPES = 256;
+    shared_mutex registryLock;
+    array<mutex, LOCK_STRIPES> accountStripes;
+    mutex ledgerLock;
+
+    // Password hashing runs on the verifier's pool, outside every lock above
+    CredentialVerifier verifier;
+    SessionCache sessions;
+    uint32_t hashIterations = DEFAULT_HASH_ITERATIONS;  // Cost of newly hashed passwords
+
+    struct SnapshotMeta {
+        bool present = false;
+        uint64_t lsn = 0;
+        uint64_t ledgerBytes = 0;
+        uint64_t ledgerRows = 0;
+    };
+
+    static SnapshotMeta readSnapshotMeta() {
+        SnapshotMeta meta;
+        ifstream file("snapshot.meta");
+        string line;
+        while (getline(file, line)) {
+            size_t eq = line.find('=');
+            if (eq == string::npos) continue;
+            string key = line.substr(0, eq);
+            uint64_t value = 0;
+            auto r = from_chars(line.data() + eq + 1, line.data() + line.size(), value);
+            if (eq + 1 == line.size() || r.ec != errc() || r.ptr != line.data() + line.size()) {
+                throw runtime_error("Invalid line in snapshot.meta: " + line);
+            }
+            if (key == "lsn") meta.lsn = value;
+            else if (key == "ledger_bytes") meta.ledgerBytes = value;
+            else if (key == "ledger_rows") meta.ledgerRows = value;
+            meta.present = true;
+        }
+        return meta;
+    }
+
+    // Replay one committed batch from the write-ahead log
+    void applyLogBatch(const char* payload, size_t length) {
+        LogReader in(payload, length);
+        while (!in.done()) {
+            uint8_t type = in.u8();
+            switch (type) {
+            case LogBatch::PUT_CUSTOMER: {
+                string id = in.str(), name = in.str(), password = in.str();
+                addCustomer(Customer(name, id, password));
+                break;
+            }
+            case LogBatch::PUT_ACCOUNT:
+            case LogBatch::PUT_ACCOUNT_DOUBLE: {
+                string accountNumber = in.str();
+                Account account(accountNumber);
+                account.deposit(type == LogBatch::PUT_ACCOUNT ? Money::fromUnits(in.i64()) : Money::fromDouble(in.f64()));
+                addAccount(account);
+                break;
+            }
+            case LogBatch::ADD_TRANSACTION:
+            case LogBatch::ADD_TRANSACTION_DATE:
+            case LogBatch::ADD_TRANSACTION_DOUBLE: {
+                string id = in.str(), from = in.str(), to = in.str();
+                Money amount = type == LogBatch::ADD_TRANSACTION_DOUBLE ? Money::fromDouble(in.f64()) : Money::fromUnits(in.i64());
+                int64_t timestamp = 0;
+                if (type == LogBatch::ADD_TRANSACTION) timestamp = in.i64();
+                else if (!parseTimestamp(in.str(), timestamp)) throw runtime_error("Invalid date in write-ahead log.");
+                uint64_t numericId = 0;
+                from_chars(id.data(), id.data() + id.size(), numericId);
+                transactionIds.advancePast(numericId);
+                transactions.push_back(Transaction(id, from, to, amount, timestamp));
+                linkHistory(accountByNumber.find(from), accountByNumber.find(to));
+                break;
+            }
+            default:
+                throw runtime_error("Unknown record type in write-ahead log.");
+            }
+        }
+    }
+
+    // Run an engine call and record its latency and outcome
+    template <typename Body>
+    BankStatus measured(Operation operation, Body body) {
+        auto start = chrono::steady_clock::now();
+        BankStatus status = body();
+        auto nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        bankMetrics.record(operation, static_cast<uint64_t>(nanos), status == BankStatus::Ok);
+        return status;
+    }
+
+    mutex& stripeFor(long long slot) {
+        return accountStripes[slot % LOCK_STRIPES];
+    }
+
+    // Link the newest ledger row into the histories of its two accounts (a
+    // negative slot is an account that no longer exists). The caller holds
+    // ledgerLock and both stripes, or is the only thread.
+    void linkHistory(long long sourceSlot, long long targetSlot) {
+        uint32_t row = static_cast<uint32_t>(historyLinks.size());
+        HistoryLink link{ NO_ROW, NO_ROW };
+        if (sourceSlot >= 0) {
+            link.prevFrom = accountHead[sourceSlot];
+            accountHead[sourceSlot] = row;
+        }
+        if (targetSlot >= 0) {
+            link.prevTo = sourceSlot == targetSlot ? link.prevFrom : accountHead[targetSlot];
+            accountHead[targetSlot] = row;
+        }
+        historyLinks.push_back(link);
+    }
+
+    // Take the history index from transactions.idx and history.heads when
+    // they match the loaded snapshot; otherwise relink every ledger row
+    void loadHistory(const SnapshotMeta& meta) {
+        TraceSpan span("load.history");
+        size_t rows = transactions.size();
+        MappedFile links("transactions.idx");
+        MappedFile heads("history.heads");
+        string_view linkBytes = links.view(), headBytes = heads.view();
+        linksOnDisk = linkBytes.size() == rows * sizeof(HistoryLink);
+
+        uint32_t magic = 0;
+        uint64_t headRows = 0, headCount = 0;
+        if (headBytes.size() >= 20) {
+            memcpy(&magic, headBytes.data(), 4);
+            memcpy(&headRows, headBytes.data() + 4, 8);
+            memcpy(&headCount, headBytes.data() + 12, 8);
+        }
+        bool headsMatch = magic == HEADS_MAGIC && headRows == rows && headCount == accounts.size()
+            && headBytes.size() == 20 + headCount * 4;
+
+        historyLinks.clear();
+        if (linksOnDisk && headsMatch && meta.present && meta.ledgerRows == rows) {
+            historyLinks.resize(rows);
+            if (rows > 0) memcpy(historyLinks.data(), linkBytes.data(), linkBytes.size());
+            for (size_t slot = 0; slot < accountHead.size(); slot++) {
+                memcpy(&accountHead[slot], headBytes.data() + 20 + slot * 4, 4);
+            }
+            return;
+        }
+
+        historyLinks.reserve(rows);
+        fill(accountHead.begin(), accountHead.end(), NO_ROW);
+        for (const auto& tx : transactions) {
+            linkHistory(accountByNumber.find(tx.getFromAccount()), accountByNumber.find(tx.getToAccount()));
+        }
+    }
+
+public:
+    explicit BankingSystem(bool durable = true) : durable(durable) {
+        if (!durable) return;
+
+        SnapshotMeta meta;
+        try {
+            meta = readSnapshotMeta();
+            // Ledger rows appended by a snapshot that never finished are replayed from the log instead
+            if (meta.present && filesystem::exists("transactions.txt")
+                && filesystem::file_size("transactions.txt") > meta.ledgerBytes) {
+                filesystem::resize_file("transactions.txt", meta.ledgerBytes);
+            }
+            uint64_t linkBytes = meta.ledgerRows * sizeof(HistoryLink);
+            if (meta.present && filesystem::exists("transactions.idx")
+                && filesystem::file_size("transactions.idx") > linkBytes) {
+                filesystem::resize_file("transactions.idx", linkBytes);
+            }
+            snapshotLsn = meta.lsn;
+
+            loadCustomers();
+            loadAccounts();
+            loadTransactions();
+            ledgerRows = transactions.size();
+            ledgerFileBytes = filesystem::exists("transactions.txt") ? filesystem::file_size("transactions.txt") : 0;
+            loadHistory(meta);
+        }
+        catch (const exception& e) {
+            // The tables are partial; writing them back would destroy the rest
+            readOnly = true;
+            cout << LIGHT_RED << "Error loading data: " << e.what() << RESET << endl;
+            cout << LIGHT_RED << "Running read-only; the data files are left untouched." << RESET << endl;
+            return;
+        }
+
+        try {
+            // Only the log tail after the snapshot is replayed
+            TraceSpan span("load.wal");
+            wal.open("bank.wal", snapshotLsn + 1, [&](uint64_t lsn, const char* payload, size_t length) {
+                if (lsn > snapshotLsn) applyLogBatch(payload, length);
+            });
+        }
+        catch (const exception& e) {
+            readOnly = true;
+            cout << LIGHT_RED << "Error opening transaction log: " << e.what() << RESET << endl;
+            cout << LIGHT_RED << "Running read-only; the data files are left untouched." << RESET << endl;
+        }
+    }
+
+    ~BankingSystem() {
+        try {
+            if (durable && !readOnly && wal.sizeBytes() > 0) writeSnapshot();
+        }
+        catch (const exception& e) {
+            cout << LIGHT_RED << "Error writing snapshot: " << e.what() << RESET << endl;
+        }
+    }
+
+    // Compact the log: append the log's transactions to transactions.txt,
+    // rewrite customers.txt and accounts.txt with one record each (via temp
+    // file + rename), record the covered LSN in snapshot.meta and empty the
+    // log. Every step is safe to crash after, because log records are
+    // absolute and the meta file fences the ledger and its history links;
+    // history.heads is only trusted when its row count matches the meta. The caller holds
+    // registryLock exclusively (or is the only thread).
+    void writeSnapshot() {
+        if (readOnly) throw runtime_error("Data failed to load; not writing a snapshot.");
+        TraceSpan span("snapshot");
+        uint64_t lsn = wal.lastLsn();
+
+        // A failed earlier attempt may have appended these rows already
+        if (filesystem::exists("transactions.txt") && filesystem::file_size("transactions.txt") > ledgerFileBytes) {
+            filesystem::resize_file("transactions.txt", ledgerFileBytes);
+        }
+        uint64_t linkBytes = ledgerRows * sizeof(HistoryLink);
+        if (linksOnDisk && filesystem::exists("transactions.idx") && filesystem::file_size("transactions.idx") > linkBytes) {
+            filesystem::resize_file("transactions.idx", linkBytes);
+        }
+
+        uint64_t ledgerBytes;
+        {
+            TraceSpan io("snapshot.ledger");
+            string ledger;
+            for (size_t i = ledgerRows; i < transactions.size(); i++) {
+                ledger += transactions[i].toString();
+            }
+            ledgerBytes = appendFileDurably("transactions.txt", ledger);
+        }
+
+        {
+            // Append the new rows' history links, or write them all if the file
+            // does not yet hold exactly the earlier rows
+            TraceSpan io("snapshot.history");
+            size_t firstLink = linksOnDisk ? ledgerRows : 0;
+            string links(reinterpret_cast<const char*>(historyLinks.data() + firstLink),
+                (historyLinks.size() - firstLink) * sizeof(HistoryLink));
+            if (linksOnDisk) appendFileDurably("transactions.idx", links);
+            else writeFileAtomically("transactions.idx", links);
+            linksOnDisk = true;
+        }
+
+        {
+            TraceSpan io("snapshot.customers");
+            string customerRows;
+            for (const auto& customer : customers) customerRows += customer.toString();
+            writeFileAtomically("customers.txt", customerRows);
+        }
+
+        {
+            TraceSpan io("snapshot.accounts");
+            string accountRows;
+            for (const auto& account : accounts) accountRows += account.toString();
+            writeFileAtomically("accounts.txt", accountRows);
+
+            string heads(20 + accountHead.size() * 4, '\0');
+            uint32_t magic = HEADS_MAGIC;
+            uint64_t rows = transactions.size(), count = accountHead.size();
+            memcpy(&heads[0], &magic, 4);
+            memcpy(&heads[4], &rows, 8);
+            memcpy(&heads[12], &count, 8);
+            for (size_t slot = 0; slot < accountHead.size(); slot++) {
+                memcpy(&heads[20 + slot * 4], &accountHead[slot], 4);
+            }
+            writeFileAtomically("history.heads", heads);
+        }
+
+        {
+            TraceSpan io("snapshot.meta");
+            stringstream meta;
+            meta << "lsn=" << lsn << "\n"
+                << "ledger_bytes=" << ledgerBytes << "\n"
+                << "ledger_rows=" << transactions.size() << "\n";
+            writeFileAtomically("snapshot.meta", meta.str());
+            wal.truncate();
+        }
+        snapshotLsn = lsn;
+        ledgerRows = transactions.size();
+        ledgerFileBytes = ledgerBytes;
+    }
+
+    // The loaders map each file and split fields in place; a missing file
+    // just means nothing was saved before the write-ahead log
+
+    void loadCustomers() {
+        TraceSpan span("load.customers");
+        MappedFile file("customers.txt");
+        string_view text = file.view();
+        customerById.reserve(customers.size() + countLines(text));
+        customerByName.reserve(customers.size() + countLines(text));
+        forEachLine(text, [&](string_view line, size_t) {
+            auto f = splitFields<3>(line);
+            addCustomer(Customer(string(f[1]), string(f[0]), string(f[2])));
+        });
+    }
+
+    void loadAccounts() {
+        TraceSpan span("load.accounts");
+        MappedFile file("accounts.txt");
+        string_view text = file.view();
+        accountByNumber.reserve(accounts.size() + countLines(text));
+        forEachLine(text, [&](string_view line, size_t lineNumber) {
+            auto f = splitFields<2>(line);
+            Account acc{ string(f[0]) };
+            acc.deposit(parseAmount(f[1], "accounts.txt", lineNumber));
+            addAccount(acc);
+        });
+    }
+
+    void loadTransactions() {
+        TraceSpan span("load.transactions");
+        MappedFile file("transactions.txt");
+        string_view text = file.view();
+        transactions.reserve(transactions.size() + countLines(text));
+        uint64_t highestId = 0;
+        forEachLine(text, [&](string_view line, size_t lineNumber) {
+            auto f = splitFields<5>(line);
+            uint64_t id = 0;
+            from_chars(f[0].data(), f[0].data() + f[0].size(), id);
+            highestId = max(highestId, id);
+            transactions.emplace_back(string(f[0]), string(f[1]), string(f[2]),
+                parseAmount(f[3], "transactions.txt", lineNumber), parseTimestampField(f[4], "transactions.txt", lineNumber));
+        });
+        transactionIds.advancePast(highestId);
+    }
+
+    // Durably record a batch of changes before they are applied in memory;
+    // throws if the log cannot be written, and the caller then leaves memory
+    // untouched. The caller holds the locks covering everything in the batch
+    // until it has applied it.
+    void persist(const LogBatch& batch) {
+        if (!durable) return;
+        if (readOnly) throw runtime_error("Data failed to load; changes are disabled.");
+        auto start = chrono::steady_clock::now();
+        bool ok = false;
+        try {
+            wal.commit(batch);
+            ok = true;
+        }
+        catch (...) {
+            recordPersist(start, ok);
+            throw;
+        }
+        recordPersist(start, ok);
+    }
+
+    static void recordPersist(chrono::steady_clock::time_point start, bool ok) {
+        auto nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        bankMetrics.record(Operation::Persist, static_cast<uint64_t>(nanos), ok);
+    }
+
+    // Snapshot once the log tail is large. Taking registryLock exclusively
+    // waits out every operation in flight, so the snapshot is consistent.
+    // Called with no locks held, after the change itself is committed, so a
+    // failure is not the caller's: the log still holds everything, the
+    // failure is counted and reported on stderr, and the snapshot is retried
+    // once the log has grown by another SNAPSHOT_LOG_BYTES.
+    void compactIfNeeded() {
+        if (!durable || readOnly || wal.sizeBytes() < snapshotAtBytes) return;
+        auto start = chrono::steady_clock::now();
+        bool ok = true;
+        try {
+            unique_lock<shared_mutex> registry(registryLock);
+            if (wal.sizeBytes() < snapshotAtBytes) return;
+            // Timed from here: the wait for operations in flight is not the snapshot's cost
+            start = chrono::steady_clock::now();
+            writeSnapshot();
+            snapshotAtBytes = SNAPSHOT_LOG_BYTES;
+        }
+        catch (const exception& e) {
+            ok = false;
+            snapshotAtBytes = wal.sizeBytes() + SNAPSHOT_LOG_BYTES;
+            cerr << LIGHT_YELLOW << "Snapshot failed (" << e.what() << "); the write-ahead log keeps every change and "
+                << "the snapshot will be retried." << RESET << endl;
+        }
+        auto nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        bankMetrics.record(Operation::Snapshot, static_cast<uint64_t>(nanos), ok);
+    }
+
+    // Add a customer and index it by ID and name; a repeated ID replaces the earlier record
+    Customer& addCustomer(const Customer& customer) {
+        long long slot = customerById.find(customer.id);
+        if (slot >= 0) {
+            // Unlink the old name unless another customer has taken it since
+            const string& oldName = customers[slot].name;
+            if (oldName != customer.name && customerByName.find(oldName) == slot) customerByName.erase(oldName);
+            customers[slot] = customer;
+        }
+        else {
+            slot = static_cast<long long>(customers.size());
+            customers.push_back(customer);
+            customerById.put(customer.id, static_cast<uint32_t>(slot));
+        }
+        customerByName.put(customer.name, static_cast<uint32_t>(slot));
+        return customers[slot];
+    }
+
+    // Add an account and index it by number; a repeated number replaces the
+    // earlier record, so the latest saved balance wins
+    Account& addAccount(const Account& account) {
+        long long slot = accountByNumber.find(account.getAccountNumber());
+        if (slot >= 0) {
+            accounts[slot] = account;
+        }
+        else {
+            slot = static_cast<long long>(accounts.size());
+            accounts.push_back(account);
+            accountHead.push_back(NO_ROW);
+            accountByNumber.put(account.getAccountNumber(), static_cast<uint32_t>(slot));
+        }
+        return accounts[slot];
+    }
+
+    Customer* findCustomerById(const string& id) {
+        long long slot = customerById.find(id);
+        return (slot >= 0) ? &customers[slot] : nullptr;
+    }
+
+    Customer* findCustomerByName(const string& name) {
+        long long slot = customerByName.find(name);
+        return (slot >= 0) ? &customers[slot] : nullptr;
+    }
+
+    Account* findAccountByAccountNumber(const string& accountNumber) {
+        long long slot = accountByNumber.find(accountNumber);
+        return (slot >= 0) ? &accounts[slot] : nullptr;
+    }
+
+    string generateCustomerId() {
+        stringstream ss;
+        ss << "CUST" << setw(3) << setfill('0') << customers.size() + 1;
+        return ss.str();
+    }
+
+    // ---------- Engine API ----------
+    // Safe to call from any number of sessions at once. Every call reports
+    // its outcome as a BankStatus and never reads or writes the console.
+
+    // Create a customer with an empty account of the same number; sets id
+    BankStatus openCustomer(const string& name, const string& password, string& id) {
+        return measured(Operation::Register, [&] {
+            try {
+                string credential = verifier.hash(password, hashIterations);
+                unique_lock<shared_mutex> registry(registryLock);
+                if (findCustomerByName(name)) return BankStatus::NameTaken;
+
+                string newId = generateCustomerId();
+                Customer newCustomer(name, newId, credential);
+                Account newAccount(newId);
+                LogBatch batch;
+                batch.putCustomer(newCustomer);
+                batch.putAccount(newAccount);
+                persist(batch);
+                addCustomer(newCustomer);
+                addAccount(newAccount);
+                id = newId;
+            }
+            catch (const exception&) {
+                return BankStatus::StorageError;
+            }
+            compactIfNeeded();
+            return BankStatus::Ok;
+        });
+    }
+
+    // Check an ID and password; sets customer on success. Unknown IDs are
+    // checked against a decoy hash so they take as long as wrong passwords,
+    // and a legacy plaintext password is replaced by its hash once it matches.
+    // That upgrade is best effort: if it cannot be logged the old credential
+    // stays and the login still succeeds.
+    BankStatus authenticate(const string& id, const string& password, Customer*& customer) {
+        return measured(Operation::Authenticate, [&] {
+            Customer* match;
+            string credential;
+            {
+                shared_lock<shared_mutex> registry(registryLock);
+                match = findCustomerById(id);
+                if (match) credential = match->password;
+            }
+            if (!match) {
+                verifier.verify(PASSWORD_HASH_PREFIX + to_string(hashIterations) + "$00$00", password);
+                return BankStatus::InvalidCredentials;
+            }
+            if (!verifier.verify(credential, password)) return BankStatus::InvalidCredentials;
+            customer = match;
+            if (isPasswordHash(credential)) return BankStatus::Ok;
+
+            try {
+                string upgraded = verifier.hash(password, hashIterations);
+                unique_lock<shared_mutex> registry(registryLock);
+                if (match->password == credential) {
+                    Customer updated = *match;
+                    updated.password = upgraded;
+                    LogBatch batch;
+                    batch.putCustomer(updated);
+                    persist(batch);
+                    match->password = upgraded;
+                }
+            }
+            catch (const exception&) {
+                return BankStatus::Ok;  // Retried at the next login
+            }
+            compactIfNeeded();
+            return BankStatus::Ok;
+        });
+    }
+
+    // authenticate() and open a session; token is what later calls present
+    BankStatus login(const string& id, const string& password, string& token) {
+        Customer* customer = nullptr;
+        BankStatus status = authenticate(id, password, customer);
+        if (status == BankStatus::Ok) token = sessions.issue(customer->id);
+        return status;
+    }
+
+    // The customer behind a live session token
+    BankStatus checkSession(const string& token, string& customerId) {
+        return sessions.check(token, customerId) ? BankStatus::Ok : BankStatus::SessionExpired;
+    }
+
+    void logout(const string& token) {
+        sessions.revoke(token);
+    }
+
+    // Iterations for passwords hashed from now on; existing hashes keep their own
+    void setHashIterations(uint32_t iterations) {
+        hashIterations = max(1u, iterations);
+    }
+
+    unsigned verifierThreads() const {
+        return verifier.threadCount();
+    }
+
+    BankStatus balanceOf(const string& accountNumber, Money& balance) {
+        return measured(Operation::Lookup, [&] {
+            shared_lock<shared_mutex> registry(registryLock);
+            long long slot = accountByNumber.find(accountNumber);
+            if (slot < 0) return BankStatus::AccountNotFound;
+            lock_guard<mutex> account(stripeFor(slot));
+            balance = accounts[slot].getBalance();
+            return BankStatus::Ok;
+        });
+    }
+
+    // Deposit; sets newBalance when given
+    BankStatus deposit(const string& accountNumber, Money amount, Money* newBalance = nullptr) {
+        return measured(Operation::Deposit, [&] {
+            if (!amount.isPositive()) return BankStatus::InvalidAmount;
+            try {
+                shared_lock<shared_mutex> registry(registryLock);
+                long long slot = accountByNumber.find(accountNumber);
+                if (slot < 0) return BankStatus::AccountNotFound;
+                lock_guard<mutex> lock(stripeFor(slot));
+                if (!accounts[slot].getBalance().canAdd(amount)) return BankStatus::InvalidAmount;
+                Account updated = accounts[slot];
+                updated.deposit(amount);
+                LogBatch batch;
+                batch.putAccount(updated);
+                persist(batch);
+                accounts[slot] = updated;
+                if (newBalance) *newBalance = updated.getBalance();
+            }
+            catch (const exception&) {
+                return BankStatus::StorageError;
+            }
+            compactIfNeeded();
+            return BankStatus::Ok;
+        });
+    }
+
+    // Withdraw; sets newBalance when given
+    BankStatus withdraw(const string& accountNumber, Money amount, Money* newBalance = nullptr) {
+        return measured(Operation::Withdraw, [&] {
+            if (!amount.isPositive()) return BankStatus::InvalidAmount;
+            try {
+                shared_lock<shared_mutex> registry(registryLock);
+                long long slot = accountByNumber.find(accountNumber);
+                if (slot < 0) return BankStatus::AccountNotFound;
+                lock_guard<mutex> lock(stripeFor(slot));
+                if (accounts[slot].getBalance() < amount) return BankStatus::InsufficientFunds;
+                Account updated = accounts[slot];
+                updated.withdraw(amount);
+                LogBatch batch;
+                batch.putAccount(updated);
+                persist(batch);
+                accounts[slot] = updated;
+                if (newBalance) *newBalance = updated.getBalance();
+            }
+            catch (const exception&) {
+                return BankStatus::StorageError;
+            }
+            compactIfNeeded();
+            return BankStatus::Ok;
+        });
+    }
+
+    // Move money between two accounts atomically; sets record when given.
+    // The two stripe locks are always taken lowest stripe first (once if
+    // both accounts share a stripe), so transfers running in opposite
+    // directions cannot deadlock.
+    BankStatus transfer(const string& fromAccount, const string& toAccount, Money amount, Transaction* record = nullptr) {
+        return measured(Operation::Transfer, [&] {
+            if (!amount.isPositive()) return BankStatus::InvalidAmount;
+            if (fromAccount == toAccount) return BankStatus::SameAccount;
+            try {
+                shared_lock<shared_mutex> registry(registryLock);
+                long long sourceSlot = accountByNumber.find(fromAccount);
+                long long targetSlot = accountByNumber.find(toAccount);
+                if (sourceSlot < 0 || targetSlot < 0) return BankStatus::AccountNotFound;
+                size_t firstStripe = min(sourceSlot % LOCK_STRIPES, targetSlot % LOCK_STRIPES);
+                size_t secondStripe = max(sourceSlot % LOCK_STRIPES, targetSlot % LOCK_STRIPES);
+                unique_lock<mutex> first(accountStripes[firstStripe]);
+                unique_lock<mutex> second;
+                if (secondStripe != firstStripe) second = unique_lock<mutex>(accountStripes[secondStripe]);
+
+                if (accounts[sourceSlot].getBalance() < amount) return BankStatus::InsufficientFunds;
+                if (!accounts[targetSlot].getBalance().canAdd(amount)) return BankStatus::InvalidAmount;
+                Account source = accounts[sourceSlot];
+                Account target = accounts[targetSlot];
+                source.transfer(target, amount);
+
+                Transaction newTransaction(fromAccount, toAccount, amount);
+                LogBatch batch;
+                batch.putAccount(source);
+                batch.putAccount(target);
+                batch.addTransaction(newTransaction);
+                persist(batch);
+
+                accounts[sourceSlot] = source;
+                accounts[targetSlot] = target;
+                {
+                    lock_guard<mutex> ledger(ledgerLock);
+                    transactions.push_back(newTransaction);
+                    linkHistory(sourceSlot, targetSlot);
+                }
+                if (record) *record = newTransaction;
+            }
+            catch (const exception&) {
+                return BankStatus::StorageError;
+            }
+            compactIfNeeded();
+            return BankStatus::Ok;
+        });
+    }
+
+    // Up to limit of an account's transactions, newest first. Pass cursor 0
+    // for the newest page and the returned nextCursor for each older one;
+    // nextCursor is 0 after the oldest. Costs time proportional to the page.
+    BankStatus history(const string& accountNumber, size_t limit, uint64_t cursor,
+        vector<Transaction>& page, uint64_t& nextCursor) {
+        return measured(Operation::Lookup, [&] {
+            page.clear();
+            nextCursor = 0;
+            shared_lock<shared_mutex> registry(registryLock);
+            long long slot = accountByNumber.find(accountNumber);
+            if (slot < 0) return BankStatus::AccountNotFound;
+
+            uint32_t row;
+            {
+                lock_guard<mutex> account(stripeFor(slot));
+                row = accountHead[slot];
+            }
+            lock_guard<mutex> ledger(ledgerLock);
+            if (cursor != 0) {
+                // A cursor is the next row to show plus one, and must be one of this account's rows
+                if (cursor > transactions.size()) return BankStatus::InvalidCursor;
+                row = static_cast<uint32_t>(cursor - 1);
+                const Transaction& tx = transactions[row];
+                if (tx.getFromAccount() != accountNumber && tx.getToAccount() != accountNumber) {
+                    return BankStatus::InvalidCursor;
+                }
+            }
+            while (row != NO_ROW && page.size() < limit) {
+                const Transaction& tx = transactions[row];
+                page.push_back(tx);
+                row = tx.getFromAccount() == accountNumber ? historyLinks[row].prevFrom : historyLinks[row].prevTo;
+            }
+            if (row != NO_ROW) nextCursor = uint64_t(row) + 1;
+            return BankStatus::Ok;
+        });
     }
 
-    Account* findAccountByAccountNumber(const string& accountNumber) {
-        auto it = find_if(accounts.begin(), accounts.end(), [&](const Account& account) {
-            return account.getAccountNumber() == accountNumber;
-            });
-        return (it != accounts.end()) ? &(*it) : nullptr;
+    // Sum of every balance, taken at a single consistent point
+    Money totalBalance() {
+        unique_lock<shared_mutex> registry(registryLock);
+        Money total;
+        for (const auto& account : accounts) total += account.getBalance();
+        return total;
     }
 
-    string generateCustomerId() {
-        stringstream ss;
-        ss << "CUST" << setw(3) << setfill('0') << customers.size() + 1;
-        return ss.str();
+    size_t transactionCount() {
+        lock_guard<mutex> ledger(ledgerLock);
+        return transactions.size();
     }
 
+    // ---------- Console front end ----------
+
     void registerCustomer() {
         try {
             string name, password;
             cout << LIGHT_BLUE << "Please enter your name: " << RESET;
             getline(cin, name);
-            cout << LIGHT_BLUE << "Please enter your password: " << RESET;
-
-            char ch;
-            password = "";
-            while ((ch = _getch()) != '\r') {
-                if (ch == '\b' && !password.empty()) {
-                    password.pop_back();
-                    cout << "\b \b";
-                }
-                else if (ch != '\b') {
-                    password.push_back(ch);
-                    cout << '*';
-                }
-            }
-            cout << endl;
+            password = getPasswordInput("Please enter your password: ");
 
-            for (auto& c : customers) {
-                if (c.name == name) {
-                    cout << LIGHT_RED << "A user with this name already exists! Please choose a different username." << RESET << endl;
-                    return;
-                }
+            string id;
+            BankStatus status = openCustomer(name, password, id);
+            if (status == BankStatus::Ok) {
+                cout << LIGHT_GREEN << "Registration successful! Your ID is: " << id << RESET << endl;
+            }
+            else {
+                reportFailure(status);
             }
-
-            string id = generateCustomerId();
-            Customer newCustomer(name, id, password);
-            customers.push_back(newCustomer);
-            saveCustomer(newCustomer);
-
-            Account newAccount(id);
-            accounts.push_back(newAccount);
-            saveAccount(newAccount);
-
-            cout << LIGHT_GREEN << "Registration successful! Your ID is: " << id << RESET << endl;
         }
         catch (const exception& e) {
             cout << LIGHT_RED << "Error during registration: " << e.what() << RESET << endl;
@@ -316,26 +2720,13 @@ public:
             string id, password;
             cout << LIGHT_BLUE << "Please enter your ID: " << RESET;
             getline(cin, id);
-            cout << LIGHT_BLUE << "Please enter your password: " << RESET;
-
-            char ch;
-            password = "";
-            while ((ch = _getch()) != '\r') {
-                if (ch == '\b' && !password.empty()) {
-                    password.pop_back();
-                    cout << "\b \b";
-                }
-                else if (ch != '\b') {
-                    password.push_back(ch);
-                    cout << '*';
-                }
-            }
-            cout << endl;
+            password = getPasswordInput("Please enter your password: ");
 
-            Customer* customer = findCustomerById(id);
-            if (customer && customer->password == password) {
+            Customer* customer = nullptr;
+            if (authenticate(id, password, customer) == BankStatus::Ok) {
                 customer->logIn();
                 currentCustomer = customer;
+                currentSession = sessions.issue(customer->id);
                 cout << LIGHT_GREEN << "Login successful!" << RESET << endl;
                 customerDashboard();
             }
@@ -371,6 +2762,14 @@ public:
 
                 cin.ignore();  // To discard any leftover newline character
 
+                // Every action rides on the login's session rather than the password
+                string sessionCustomer;
+                if (choice != 6 && (checkSession(currentSession, sessionCustomer) != BankStatus::Ok
+                    || sessionCustomer != currentCustomer->id)) {
+                    reportFailure(BankStatus::SessionExpired);
+                    choice = 6;
+                }
+
                 switch (choice) {
                 case 1:
                     showAccountBalance(*currentCustomer);
@@ -385,10 +2784,12 @@ public:
                     transferFunds(*currentCustomer);
                     break;
                 case 5:
-                    viewRecentTransactions();
+                    viewRecentTransactions(*currentCustomer);
                     break;
                 case 6:
                     cout << LIGHT_GREEN << "Logged out successfully!" << RESET << endl;
+                    logout(currentSession);
+                    currentSession.clear();
                     currentCustomer->logOut();
                     currentCustomer = nullptr;
                     break;
@@ -402,41 +2803,56 @@ public:
         }
     }
 
-    void viewRecentTransactions() {
+    // Page through the customer's own transactions, newest first
+    void viewRecentTransactions(Customer& customer) {
+        const size_t PAGE_SIZE = 10;
+        vector<Transaction> page;
+        uint64_t cursor = 0;
         cout << "===== Recent Transactions =====" << endl;
-        for (const auto& tx : transactions) {
-            cout << tx.toString();
+        while (true) {
+            BankStatus status = history(customer.id, PAGE_SIZE, cursor, page, cursor);
+            if (status != BankStatus::Ok) {
+                reportFailure(status);
+                return;
+            }
+            if (page.empty()) cout << "No transactions yet." << endl;
+            for (const auto& tx : page) {
+                cout << tx.toDisplayString();
+            }
+            if (cursor == 0) return;
+
+            string answer;
+            cout << LIGHT_YELLOW << "Show older transactions? (y/n): " << RESET;
+            getline(cin, answer);
+            if (answer != "y" && answer != "Y") return;
         }
     }
 
-    void showAccountBalance(Customer& customer) {
-        string accountNumber = customer.id;
+    void reportFailure(BankStatus status) {
+        cout << LIGHT_RED << "Error: " << statusMessage(status) << RESET << endl;
+    }
 
-        Account* account = findAccountByAccountNumber(accountNumber);
-        if (account) {
-            cout << "Balance: $" << fixed << setprecision(2) << account->getBalance() << endl;
+    void showAccountBalance(Customer& customer) {
+        Money balance;
+        BankStatus status = balanceOf(customer.id, balance);
+        if (status == BankStatus::Ok) {
+            cout << "Balance: $" << balance << endl;
         }
         else {
-            cout << LIGHT_RED << "Account not found!" << RESET << endl;
+            reportFailure(status);
         }
     }
 
     void depositToAccount(Customer& customer) {
         try {
-            double amount;
             cout << "Enter amount to deposit: $";
-            cin >> amount;
-            if (amount <= 0) throw invalid_argument("Deposit amount must be positive.");
-
-            string accountNumber = customer.id;
-            Account* account = findAccountByAccountNumber(accountNumber);
-            if (account) {
-                account->deposit(amount);
-                saveAccount(*account);
+            Money amount = readMoney();
+            BankStatus status = deposit(customer.id, amount);
+            if (status == BankStatus::Ok) {
                 cout << LIGHT_GREEN << "Deposited $" << amount << " successfully!" << RESET << endl;
             }
             else {
-                cout << LIGHT_RED << "Account not found!" << RESET << endl;
+                reportFailure(status);
             }
         }
         catch (const exception& e) {
@@ -446,20 +2862,14 @@ public:
 
     void withdrawFromAccount(Customer& customer) {
         try {
-            double amount;
             cout << "Enter amount to withdraw: $";
-            cin >> amount;
-            if (amount <= 0) throw invalid_argument("Withdrawal amount must be positive.");
-
-            string accountNumber = customer.id;
-            Account* account = findAccountByAccountNumber(accountNumber);
-            if (account) {
-                account->withdraw(amount);
-                saveAccount(*account);
+            Money amount = readMoney();
+            BankStatus status = withdraw(customer.id, amount);
+            if (status == BankStatus::Ok) {
                 cout << LIGHT_GREEN << "Withdrew $" << amount << " successfully!" << RESET << endl;
             }
             else {
-                cout << LIGHT_RED << "Account not found!" << RESET << endl;
+                reportFailure(status);
             }
         }
         catch (const exception& e) {
@@ -469,29 +2879,19 @@ public:
 
     void transferFunds(Customer& customer) {
         try {
-            double amount;
             cout << "Enter amount to transfer: $";
-            cin >> amount;
-            if (amount <= 0) throw invalid_argument("Transfer amount must be positive.");
+            Money amount = readMoney();
 
             string targetAccountNumber;
             cout << "Enter target account number: ";
             cin >> targetAccountNumber;
 
-            Account* sourceAccount = findAccountByAccountNumber(customer.id);
-            Account* targetAccount = findAccountByAccountNumber(targetAccountNumber);
-
-            if (sourceAccount && targetAccount) {
-                sourceAccount->transfer(*targetAccount, amount);
-                Transaction newTransaction(customer.id, targetAccountNumber, amount);
-                transactions.push_back(newTransaction);
-                saveTransaction(newTransaction);
-                saveAccount(*sourceAccount);
-                saveAccount(*targetAccount);
+            BankStatus status = transfer(customer.id, targetAccountNumber, amount);
+            if (status == BankStatus::Ok) {
                 cout << LIGHT_GREEN << "Transferred $" << amount << " successfully!" << RESET << endl;
             }
             else {
-                cout << LIGHT_RED << "Account not found!" << RESET << endl;
+                reportFailure(status);
             }
         }
         catch (const exception& e) {
@@ -500,32 +2900,982 @@ public:
     }
 };
 
-int main() {
+// Temporary working directory for self-contained runs: entered on
+// construction, left and deleted on destruction
+class ScratchDirectory {
+private:
+    filesystem::path previous;
+    filesystem::path path;
+
+public:
+    explicit ScratchDirectory(const string& prefix) {
+        previous = filesystem::current_path();
+        path = filesystem::temp_directory_path() / (prefix + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+        filesystem::create_directories(path);
+        filesystem::current_path(path);
+    }
+
+    ~ScratchDirectory() {
+        error_code ignored;
+        filesystem::current_path(previous, ignored);
+        filesystem::remove_all(path, ignored);
+    }
+
+    ScratchDirectory(const ScratchDirectory&) = delete;
+    ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+};
+
+// ---------- Concurrency stress test ----------
+// Seeds accounts, runs random transfers from many threads at once and checks
+// that no money was created or destroyed. By default the engine runs in
+// memory; --durable runs it against the write-ahead log in a scratch
+// directory and also checks the balances that come back after a restart.
+
+struct StressOptions {
+    size_t accountCount = 1000;
+    unsigned threadCount = max(4u, thread::hardware_concurrency());
+    size_t transferCount = 2000000;
+    bool durable = false;
+};
+
+int runStressTest(const StressOptions& options) {
+    const Money openingBalance = Money::fromUnits(1000 * Money::SCALE);
+    unique_ptr<ScratchDirectory> scratch;
+    if (options.durable) scratch = make_unique<ScratchDirectory>("bank_stress_");
+
+    bool passed = true;
     try {
-        BankingSystem bankSystem;
-        int choice;
-        while (true) {
-            cout << "\n===== Banking System =====" << endl;
-            cout << "1. Register" << endl;
-            cout << "2. Login" << endl;
-            cout << "3. Exit" << endl;
-            cout << LIGHT_YELLOW << "Select an option: " << RESET;
-            cin >> choice;
-            cin.ignore();  // Discard any leftover newline character
-
-            switch (choice) {
-            case 1:
-                bankSystem.registerCustomer();
-                break;
-            case 2:
-                bankSystem.loginCustomer();
-                break;
-            case 3:
-                cout << "Exiting system..." << endl;
-                return 0;
-            default:
-                cout << LIGHT_RED << "Invalid choice!" << RESET << endl;
+        Money expected;
+        size_t completed = 0;
+        {
+            BankingSystem bank(options.durable);
+            bank.setHashIterations(1);  // Passwords play no part in this test
+            vector<string> accountNumbers;
+            for (size_t i = 0; i < options.accountCount; i++) {
+                string id;
+                BankStatus status = bank.openCustomer("stress" + to_string(i), "stress", id);
+                if (status == BankStatus::Ok) status = bank.deposit(id, openingBalance);
+                if (status != BankStatus::Ok) throw runtime_error(string("Seeding failed: ") + statusName(status));
+                accountNumbers.push_back(id);
+            }
+            expected = bank.totalBalance();
+            size_t ledgerBefore = bank.transactionCount();
+
+            atomic<size_t> nextTransfer{ 0 };
+            atomic<size_t> succeeded{ 0 }, rejected{ 0 }, unexpected{ 0 };
+            auto worker = [&](unsigned seed) {
+                mt19937_64 random(seed);
+                uniform_int_distribution<size_t> pickAccount(0, accountNumbers.size() - 1);
+                uniform_int_distribution<int64_t> pickCents(1, 500 * Money::SCALE);
+                size_t ok = 0, failed = 0, other = 0;
+                while (nextTransfer.fetch_add(1, memory_order_relaxed) < options.transferCount) {
+                    size_t from = pickAccount(random), to = pickAccount(random);
+                    if (from == to) to = (to + 1) % accountNumbers.size();
+                    BankStatus status = bank.transfer(accountNumbers[from], accountNumbers[to], Money::fromUnits(pickCents(random)));
+                    if (status == BankStatus::Ok) ok++;
+                    else if (status == BankStatus::InsufficientFunds) failed++;
+                    else other++;
+                }
+                succeeded += ok;
+                rejected += failed;
+                unexpected += other;
+            };
+
+            auto start = chrono::steady_clock::now();
+            vector<thread> workers;
+            for (unsigned t = 0; t < options.threadCount; t++) workers.emplace_back(worker, t + 1);
+            for (auto& w : workers) w.join();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            Money actual = bank.totalBalance();
+            completed = succeeded;
+            cout << "Transfers: " << succeeded << " completed, " << rejected << " rejected by "
+                << options.threadCount << " threads over " << options.accountCount << " accounts in "
+                << fixed << setprecision(2) << seconds << " s ("
+                << setprecision(0) << options.transferCount / max(seconds, 1e-9) << " transfers/sec)" << endl;
+            cout << "Total balance: $" << expected << " before, $" << actual << " after" << endl;
+            if (actual != expected) {
+                cout << LIGHT_RED << "FAIL: total balance changed by $" << (actual - expected) << RESET << endl;
+                passed = false;
+            }
+            if (unexpected > 0) {
+                cout << LIGHT_RED << "FAIL: " << unexpected << " transfers failed for a reason other than funds" << RESET << endl;
+                passed = false;
+            }
+            if (bank.transactionCount() - ledgerBefore != completed) {
+                cout << LIGHT_RED << "FAIL: " << bank.transactionCount() - ledgerBefore
+                    << " ledger rows for " << completed << " transfers" << RESET << endl;
+                passed = false;
+            }
+        }
+
+        if (options.durable) {
+            BankingSystem recovered;
+            Money actual = recovered.totalBalance();
+            cout << "Total balance after restart: $" << actual << endl;
+            if (actual != expected || recovered.transactionCount() != completed) {
+                cout << LIGHT_RED << "FAIL: restart did not restore the committed state" << RESET << endl;
+                passed = false;
+            }
+        }
+    }
+    catch (const exception& e) {
+        cout << LIGHT_RED << "Error: " << e.what() << RESET << endl;
+        passed = false;
+    }
+
+    if (passed) cout << LIGHT_GREEN << "PASS: money is conserved" << RESET << endl;
+    return passed ? 0 : 1;
+}
+
+// ---------- Batch command mode ----------
+// Streams one command per line through the engine API:
+//   REGISTER <name> <password>
+//   LOGIN <customer id> <password>
+//   SESSION <token>
+//   DEPOSIT <account> <amount>
+//   WITHDRAW <account> <amount>
+//   TRANSFER <from account> <to account> <amount>
+//   BALANCE <account>
+//   HISTORY <account> [limit] [cursor]
+//   METRICS <file>
+// LOGIN prints a session token and SESSION the customer ID it belongs to.
+// METRICS writes the engine metrics in Prometheus text format ("-" for
+// stdout). Words are separated by spaces, so batch names cannot contain one. Blank
+// lines and lines starting with '#' are skipped. Each command prints "OK"
+// (plus the new ID or balance) or its status name; a summary with ops/sec
+// and latency percentiles goes to stderr.
+
+struct BatchOptions {
+    string inputPath = "-";
+    bool quiet = false;  // Print only the summary
+    uint32_t hashIterations = DEFAULT_HASH_ITERATIONS;
+};
+
+// Split line on blanks into words; returns the word count, or capacity + 1
+// if there are more words than fit
+size_t splitWords(string_view line, string_view* words, size_t capacity) {
+    auto blank = [](char ch) { return ch == ' ' || ch == '\t' || ch == '\r'; };
+    size_t count = 0, i = 0;
+    while (true) {
+        while (i < line.size() && blank(line[i])) i++;
+        if (i == line.size()) return count;
+        size_t start = i;
+        while (i < line.size() && !blank(line[i])) i++;
+        if (count == capacity) return capacity + 1;
+        words[count++] = line.substr(start, i - start);
+    }
+}
+
+// Run one parsed command; result receives the value printed after "OK"
+BankStatus runCommand(BankingSystem& bank, const string_view* words, size_t count, string& result) {
+    string_view verb = words[0];
+    Money amount, balance;
+    BankStatus status = BankStatus::UnknownCommand;
+
+    if (verb == "DEPOSIT" && count == 3) {
+        if (!Money::parse(words[2], amount)) return BankStatus::InvalidAmount;
+        status = bank.deposit(string(words[1]), amount, &balance);
+        if (status == BankStatus::Ok) result = balance.toString();
+    }
+    else if (verb == "WITHDRAW" && count == 3) {
+        if (!Money::parse(words[2], amount)) return BankStatus::InvalidAmount;
+        status = bank.withdraw(string(words[1]), amount, &balance);
+        if (status == BankStatus::Ok) result = balance.toString();
+    }
+    else if (verb == "TRANSFER" && count == 4) {
+        if (!Money::parse(words[3], amount)) return BankStatus::InvalidAmount;
+        status = bank.transfer(string(words[1]), string(words[2]), amount);
+    }
+    else if (verb == "BALANCE" && count == 2) {
+        status = bank.balanceOf(string(words[1]), balance);
+        if (status == BankStatus::Ok) result = balance.toString();
+    }
+    else if (verb == "HISTORY" && count >= 2 && count <= 4) {
+        uint64_t limit = 10, cursor = 0, nextCursor = 0;
+        if (count >= 3 && from_chars(words[2].data(), words[2].data() + words[2].size(), limit).ec != errc()) {
+            return BankStatus::UnknownCommand;
+        }
+        if (count == 4 && from_chars(words[3].data(), words[3].data() + words[3].size(), cursor).ec != errc()) {
+            return BankStatus::InvalidCursor;
+        }
+        vector<Transaction> page;
+        status = bank.history(string(words[1]), limit, cursor, page, nextCursor);
+        if (status == BankStatus::Ok) {
+            // "<next cursor> <row>;<row>;..." with rows as "id,from,to,amount,d-m-yyyy hh:mm:ss"
+            result = to_string(nextCursor);
+            for (size_t i = 0; i < page.size(); i++) {
+                string row = page[i].toDisplayString();
+                row.pop_back();
+                result += (i == 0 ? " " : ";") + row;
+            }
+        }
+    }
+    else if (verb == "METRICS" && count == 2) {
+        status = bankMetrics.dump(string(words[1])) ? BankStatus::Ok : BankStatus::StorageError;
+    }
+    else if (verb == "REGISTER" && count == 3) {
+        status = bank.openCustomer(string(words[1]), string(words[2]), result);
+    }
+    else if (verb == "LOGIN" && count == 3) {
+        status = bank.login(string(words[1]), string(words[2]), result);
+    }
+    else if (verb == "SESSION" && count == 2) {
+        status = bank.checkSession(string(words[1]), result);
+    }
+    return status;
+}
+
+// Nearest-rank percentile of sorted samples
+double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size());
+    return sorted[min(rank, sorted.size() - 1)];
+}
+
+int runBatch(const BatchOptions& options) {
+    ifstream file;
+    if (options.inputPath != "-") {
+        file.open(options.inputPath);
+        if (!file) {
+            cerr << LIGHT_RED << "Unable to open " << options.inputPath << RESET << endl;
+            return 1;
+        }
+    }
+    istream& input = options.inputPath == "-" ? cin : file;
+
+    BankingSystem bank;
+    bank.setHashIterations(options.hashIterations);
+    array<size_t, BANK_STATUS_COUNT> statusCounts{};
+    vector<double> latencies;  // Microseconds per command
+    string line, result;
+    string out;
+    array<string_view, 4> words;
+    double busySeconds = 0;
+    auto start = chrono::steady_clock::now();
+
+    while (getline(input, line)) {
+        size_t count = splitWords(line, words.data(), words.size());
+        if (count == 0 || words[0][0] == '#') continue;
+
+        result.clear();
+        auto begin = chrono::steady_clock::now();
+        BankStatus status = count > words.size() ? BankStatus::UnknownCommand : runCommand(bank, words.data(), count, result);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        busySeconds += seconds;
+        latencies.push_back(seconds * 1e6);
+        statusCounts[static_cast<size_t>(status)]++;
+
+        if (!options.quiet) {
+            out += statusName(status);
+            if (status == BankStatus::Ok && !result.empty()) out += " " + result;
+            out += '\n';
+            if (out.size() >= (1 << 16)) {
+                cout << out;
+                out.clear();
+            }
+        }
+    }
+    cout << out << flush;
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    sort(latencies.begin(), latencies.end());
+    size_t failed = latencies.size() - statusCounts[static_cast<size_t>(BankStatus::Ok)];
+    cerr << "Commands: " << latencies.size() << " (" << latencies.size() - failed << " ok, " << failed << " failed";
+    for (size_t i = 1; i < BANK_STATUS_COUNT; i++) {
+        if (statusCounts[i]) cerr << ", " << statusName(static_cast<BankStatus>(i)) << " " << statusCounts[i];
+    }
+    cerr << ")" << endl;
+    cerr << fixed << setprecision(2) << "Elapsed: " << elapsed << " s, "
+        << setprecision(0) << latencies.size() / max(busySeconds, 1e-9) << " ops/sec in the engine, "
+        << latencies.size() / max(elapsed, 1e-9) << " ops/sec end to end" << endl;
+    cerr << setprecision(1) << "Latency (us): p50 " << percentile(latencies, 50)
+        << ", p99 " << percentile(latencies, 99) << ", p999 " << percentile(latencies, 99.9)
+        << ", max " << (latencies.empty() ? 0 : latencies.back()) << endl;
+    return 0;
+}
+
+// ---------- Ledger reports ----------
+
+struct ReportOptions {
+    string textPath = "transactions.txt";
+    string ledgerPath = "ledger.col";
+    string account;   // Report on this account's counterparties too
+    size_t top = 10;
+};
+
+// "2026-10-17" for a count of days since the Unix epoch (proleptic Gregorian)
+string formatDay(int64_t days) {
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t dayOfEra = z - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t mp = (5 * dayOfYear + 2) / 153;
+    int64_t day = dayOfYear - (153 * mp + 2) / 5 + 1;
+    int64_t month = mp < 10 ? mp + 3 : mp - 9;
+    int64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+    char text[64];
+    snprintf(text, sizeof(text), "%04lld-%02d-%02d", static_cast<long long>(year),
+        static_cast<int>(month), static_cast<int>(day));
+    return text;
+}
+
+// Convert the text ledger into the columnar format
+int runConvertLedger(const ReportOptions& options) {
+    try {
+        auto start = chrono::steady_clock::now();
+        ColumnarLedger ledger;
+        ledger.loadText(options.textPath);
+        ledger.save(options.ledgerPath);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << LIGHT_GREEN << "Wrote " << ledger.size() << " transactions over " << ledger.accounts.size()
+            << " accounts to " << options.ledgerPath << " in " << fixed << setprecision(2) << seconds << " s" << RESET << endl;
+        cout << "Changes still in the write-ahead log are included after the next snapshot." << endl;
+        return 0;
+    }
+    catch (const exception& e) {
+        cerr << LIGHT_RED << "Error: " << e.what() << RESET << endl;
+        return 1;
+    }
+}
+
+// Daily volume, the busiest senders and, for one account, its totals and top counterparties
+int runLedgerReport(const ReportOptions& options) {
+    auto start = chrono::steady_clock::now();
+    ColumnarLedger ledger;
+    if (!ledger.load(options.ledgerPath)) {
+        cerr << LIGHT_RED << "Unable to read columnar ledger " << options.ledgerPath
+            << " (create it with --convert-ledger)" << RESET << endl;
+        return 1;
+    }
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Ledger: " << ledger.size() << " transactions, " << ledger.accounts.size() << " accounts (loaded in "
+        << fixed << setprecision(1) << loadSeconds * 1000 << " ms)" << endl;
+
+    start = chrono::steady_clock::now();
+    auto daily = ledger.dailyVolume();
+    auto totals = ledger.accountTotals();
+    vector<uint32_t> senders(totals.size());
+    for (size_t code = 0; code < senders.size(); code++) senders[code] = static_cast<uint32_t>(code);
+    size_t keep = min(options.top, senders.size());
+    partial_sort(senders.begin(), senders.begin() + keep, senders.end(),
+        [&](uint32_t a, uint32_t b) { return totals[a].sent > totals[b].sent; });
+    senders.resize(keep);
+
+    long long code = options.account.empty() ? -1 : ledger.find(options.account);
+    vector<pair<uint32_t, Money>> counterparties;
+    if (code >= 0) counterparties = ledger.topCounterparties(static_cast<uint32_t>(code), options.top);
+    double scanSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "\n===== Daily Volume (UTC) =====" << endl;
+    for (const auto& day : daily) {
+        cout << formatDay(day.first) << "  $" << day.second << endl;
+    }
+
+    cout << "\n===== Top " << keep << " Senders =====" << endl;
+    for (uint32_t sender : senders) {
+        cout << ledger.accounts[sender] << "  sent $" << totals[sender].sent << " in " << totals[sender].sentCount
+            << ", received $" << totals[sender].received << " in " << totals[sender].receivedCount << endl;
+    }
+
+    if (!options.account.empty()) {
+        cout << "\n===== Account " << options.account << " =====" << endl;
+        if (code < 0) {
+            cout << LIGHT_RED << "No transactions for this account." << RESET << endl;
+        }
+        else {
+            const auto& own = totals[code];
+            cout << "Sent $" << own.sent << " in " << own.sentCount << ", received $" << own.received
+                << " in " << own.receivedCount << endl;
+            cout << "Top " << counterparties.size() << " counterparties:" << endl;
+            for (const auto& entry : counterparties) {
+                cout << "  " << ledger.accounts[entry.first] << "  $" << entry.second << endl;
+            }
+        }
+    }
+
+    cout << "\nScans took " << fixed << setprecision(2) << scanSeconds * 1000 << " ms ("
+        << setprecision(0) << ledger.size() / max(scanSeconds, 1e-9) << " rows/sec)" << endl;
+    return 0;
+}
+
+// ---------- Benchmark ----------
+// Registers synthetic customers through openCustomer() (the path behind
+// registerCustomer()), runs a mix of deposits, withdrawals, transfers and
+// balance queries from several threads, then times loadAccounts(),
+// loadTransactions() and a full startup on generated files of each size.
+// Results go to a CSV; against a baseline CSV any row whose throughput
+// dropped by more than the tolerance counts as a regression.
+
+struct BankBenchOptions {
+    size_t customerCount = 10000;
+    unsigned threadCount = max(4u, thread::hardware_concurrency());
+    size_t operationCount = 1000000;
+    array<unsigned, 4> mix = { 25, 25, 25, 25 };  // Deposit, withdraw, transfer, balance weights
+    bool durable = false;
+    vector<size_t> loadSizes = { 10000, 1000000, 10000000 };
+    string csvPath = "bank_bench.csv";
+    string baselinePath;
+    double tolerance = 20.0;  // Allowed throughput drop against the baseline, in percent
+    uint32_t hashIterations = 1000;  // Below the production cost, which would dominate registration; see --login-bench
+};
+
+struct BankBenchRow {
+    string phase;
+    string name;
+    size_t count = 0;
+    double seconds = 0;
+    double opsPerSec = 0;
+    double p50 = 0, p99 = 0, p999 = 0;  // Microseconds
+};
+
+BankBenchRow summarize(const string& phase, const string& name, vector<double>& latencies, double seconds) {
+    sort(latencies.begin(), latencies.end());
+    BankBenchRow row;
+    row.phase = phase;
+    row.name = name;
+    row.count = latencies.size();
+    row.seconds = seconds;
+    row.opsPerSec = latencies.size() / max(seconds, 1e-9);
+    row.p50 = percentile(latencies, 50);
+    row.p99 = percentile(latencies, 99);
+    row.p999 = percentile(latencies, 99.9);
+    return row;
+}
+
+void printBenchRow(const BankBenchRow& row) {
+    cout << left << setw(10) << row.phase << setw(26) << row.name << right << setw(10) << row.count
+        << fixed << setprecision(3) << setw(10) << row.seconds << setprecision(0) << setw(13) << row.opsPerSec
+        << setprecision(1) << setw(10) << row.p50 << setw(10) << row.p99 << setw(10) << row.p999 << endl;
+}
+
+// Write customers.txt, accounts.txt and transactions.txt with count records each
+void writeSyntheticFiles(size_t count) {
+    string customers, accounts, transactions;
+    customers.reserve(count * 32);
+    accounts.reserve(count * 24);
+    transactions.reserve(count * 64);
+    int64_t timestamp = currentTimestamp() - static_cast<int64_t>(count) * 1000;
+    mt19937_64 random(count);
+    for (size_t i = 1; i <= count; i++) {
+        string id = "CUST" + to_string(i);
+        customers += id + ",customer" + to_string(i) + ",password\n";
+        accounts += id + "," + Money::fromUnits(static_cast<int64_t>(random() % 10000000)).toString() + "\n";
+        string target = "CUST" + to_string(random() % count + 1);
+        transactions += to_string(i) + "," + id + "," + target + ","
+            + Money::fromUnits(static_cast<int64_t>(random() % 100000 + 1)).toString() + "," + to_string(timestamp + static_cast<int64_t>(i) * 1000) + "\n";
+    }
+    writeFileAtomically("customers.txt", customers);
+    writeFileAtomically("accounts.txt", accounts);
+    writeFileAtomically("transactions.txt", transactions);
+}
+
+// Whole-string non-negative integer from a command-line value
+bool parseCount(string_view text, size_t& value) {
+    auto r = from_chars(text.data(), text.data() + text.size(), value);
+    return !text.empty() && r.ec == errc() && r.ptr == text.data() + text.size();
+}
+
+// Whole-string non-negative decimal number from a command-line value or CSV field
+bool parseDecimal(const string& text, double& value) {
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && end == text.c_str() + text.size() && value >= 0 && value < numeric_limits<double>::infinity();
+}
+
+// ops/sec per "phase/name" from a CSV written by --bench; false (with the
+// file and line reported) if a row's ops/sec is not a number
+bool loadBankBaseline(const string& path, map<string, double>& baseline) {
+    ifstream file(path);
+    string line;
+    getline(file, line); // Header
+    for (size_t lineNumber = 2; getline(file, line); lineNumber++) {
+        stringstream ss(line);
+        string phase, name, count, seconds, opsPerSec;
+        getline(ss, phase, ',');
+        getline(ss, name, ',');
+        getline(ss, count, ',');
+        getline(ss, seconds, ',');
+        getline(ss, opsPerSec, ',');
+        if (opsPerSec.empty()) continue;
+        double value;
+        if (!parseDecimal(opsPerSec, value)) {
+            cerr << LIGHT_RED << "Invalid ops/sec '" << opsPerSec << "' in " << path << " line " << lineNumber << RESET << endl;
+            return false;
+        }
+        baseline[phase + "/" + name] = value;
+    }
+    return true;
+}
+
+int runBankBenchmark(const BankBenchOptions& options) {
+    vector<BankBenchRow> rows;
+    cout << LIGHT_BLUE << left << setw(10) << "phase" << setw(26) << "name" << right << setw(10) << "count"
+        << setw(10) << "seconds" << setw(13) << "ops/sec" << setw(10) << "p50 us" << setw(10) << "p99 us"
+        << setw(10) << "p999 us" << RESET << endl;
+
+    try {
+        ScratchDirectory scratch("bank_bench_");
+        {
+            BankingSystem bank(options.durable);
+            bank.setHashIterations(options.hashIterations);
+
+            // Registration, one customer and account per call
+            vector<string> accountNumbers;
+            vector<double> latencies;
+            accountNumbers.reserve(options.customerCount);
+            latencies.reserve(options.customerCount);
+            auto start = chrono::steady_clock::now();
+            for (size_t i = 0; i < options.customerCount; i++) {
+                string id;
+                auto begin = chrono::steady_clock::now();
+                BankStatus status = bank.openCustomer("bench" + to_string(i), "password", id);
+                latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count());
+                if (status != BankStatus::Ok) throw runtime_error(string("Registration failed: ") + statusName(status));
+                accountNumbers.push_back(id);
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            rows.push_back(summarize("register", "openCustomer", latencies, seconds));
+            printBenchRow(rows.back());
+
+            for (const auto& id : accountNumbers) {
+                if (bank.deposit(id, Money::fromUnits(1000 * Money::SCALE)) != BankStatus::Ok) {
+                    throw runtime_error("Unable to fund benchmark accounts.");
+                }
+            }
+
+            // Operation mix from every thread
+            static const char* OPERATION_NAMES[4] = { "deposit", "withdraw", "transfer", "balance" };
+            unsigned totalWeight = options.mix[0] + options.mix[1] + options.mix[2] + options.mix[3];
+            if (totalWeight == 0 || accountNumbers.size() < 2) throw runtime_error("Nothing to benchmark.");
+            vector<array<vector<double>, 4>> perThread(options.threadCount);
+            atomic<size_t> nextOperation{ 0 };
+            auto worker = [&](unsigned index) {
+                mt19937_64 random(index + 1);
+                uniform_int_distribution<size_t> pickAccount(0, accountNumbers.size() - 1);
+                uniform_int_distribution<unsigned> pickWeight(0, totalWeight - 1);
+                uniform_int_distribution<int64_t> pickCents(1, 100 * Money::SCALE);
+                auto& samples = perThread[index];
+                while (nextOperation.fetch_add(1, memory_order_relaxed) < options.operationCount) {
+                    unsigned weight = pickWeight(random), kind = 0;
+                    while (weight >= options.mix[kind]) weight -= options.mix[kind++];
+                    const string& account = accountNumbers[pickAccount(random)];
+                    Money amount = Money::fromUnits(pickCents(random)), balance;
+
+                    auto begin = chrono::steady_clock::now();
+                    switch (kind) {
+                    case 0: bank.deposit(account, amount); break;
+                    case 1: bank.withdraw(account, amount); break;
+                    case 2: bank.transfer(account, accountNumbers[pickAccount(random)], amount); break;
+                    default: bank.balanceOf(account, balance); break;
+                    }
+                    samples[kind].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count());
+                }
+            };
+
+            start = chrono::steady_clock::now();
+            vector<thread> workers;
+            for (unsigned t = 0; t < options.threadCount; t++) workers.emplace_back(worker, t);
+            for (auto& w : workers) w.join();
+            seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            vector<double> all;
+            for (int kind = 0; kind < 4; kind++) {
+                vector<double> merged;
+                for (auto& samples : perThread) merged.insert(merged.end(), samples[kind].begin(), samples[kind].end());
+                if (merged.empty()) continue;
+                all.insert(all.end(), merged.begin(), merged.end());
+                rows.push_back(summarize("mix", OPERATION_NAMES[kind], merged, seconds));
+                printBenchRow(rows.back());
+            }
+            rows.push_back(summarize("mix", "all x" + to_string(options.threadCount) + " threads", all, seconds));
+            printBenchRow(rows.back());
+        }
+
+        // Load times on generated files
+        for (size_t size : options.loadSizes) {
+            filesystem::path directory = "load_" + to_string(size);
+            filesystem::create_directories(directory);
+            filesystem::current_path(directory);
+            writeSyntheticFiles(size);
+
+            BankBenchRow row;
+            row.phase = "load";
+            row.count = size;
+            {
+                BankingSystem bank(false);
+                auto start = chrono::steady_clock::now();
+                bank.loadAccounts();
+                row.name = "loadAccounts " + to_string(size);
+                row.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                row.opsPerSec = size / max(row.seconds, 1e-9);
+                rows.push_back(row);
+                printBenchRow(row);
+
+                start = chrono::steady_clock::now();
+                bank.loadTransactions();
+                row.name = "loadTransactions " + to_string(size);
+                row.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                row.opsPerSec = size / max(row.seconds, 1e-9);
+                rows.push_back(row);
+                printBenchRow(row);
+            }
+            {
+                auto start = chrono::steady_clock::now();
+                BankingSystem bank;
+                row.name = "startup " + to_string(size);
+                row.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                row.opsPerSec = size / max(row.seconds, 1e-9);
+                rows.push_back(row);
+                printBenchRow(row);
+            }
+
+            filesystem::current_path("..");
+            filesystem::remove_all(directory);
+        }
+    }
+    catch (const exception& e) {
+        cerr << LIGHT_RED << "Error: " << e.what() << RESET << endl;
+        return 1;
+    }
+
+    ofstream csv(options.csvPath);
+    if (!csv.is_open()) {
+        cerr << LIGHT_RED << "Unable to write benchmark results to " << options.csvPath << RESET << endl;
+        return 1;
+    }
+    csv << "phase,name,count,seconds,ops_per_sec,p50_us,p99_us,p999_us\n";
+    csv << fixed << setprecision(3);
+    for (const auto& r : rows) {
+        csv << r.phase << ',' << r.name << ',' << r.count << ',' << r.seconds << ',' << r.opsPerSec << ','
+            << r.p50 << ',' << r.p99 << ',' << r.p999 << '\n';
+    }
+    cout << LIGHT_BLUE << "Results written to " << options.csvPath << RESET << endl;
+
+    if (options.baselinePath.empty()) return 0;
+    map<string, double> baseline;
+    if (!loadBankBaseline(options.baselinePath, baseline)) return 1;
+    if (baseline.empty()) {
+        cerr << LIGHT_RED << "No baseline rows found in " << options.baselinePath << RESET << endl;
+        return 1;
+    }
+    int regressions = 0;
+    for (const auto& r : rows) {
+        auto it = baseline.find(r.phase + "/" + r.name);
+        if (it == baseline.end() || it->second <= 0) continue;
+        double change = (it->second - r.opsPerSec) / it->second * 100.0;
+        if (change > options.tolerance) {
+            regressions++;
+            cout << LIGHT_RED << "Regression: " << r.phase << "/" << r.name << " " << it->second
+                << " -> " << r.opsPerSec << " ops/sec (-" << change << "%)" << RESET << endl;
+        }
+    }
+    cout << (regressions ? LIGHT_RED : LIGHT_GREEN) << regressions << " regressions against "
+        << options.baselinePath << " (tolerance " << options.tolerance << "%)" << RESET << endl;
+    return regressions ? 3 : 0;
+}
+
+// ---------- Login benchmark ----------
+// Registers customers at the given hashing cost, logs them in from more
+// threads than the verifier has workers (every tenth attempt with a wrong
+// password) and then checks the issued sessions, reporting logins/sec in
+// total and per verifier thread, i.e. per core.
+
+struct LoginBenchOptions {
+    size_t customerCount = 200;
+    unsigned threadCount = max(4u, thread::hardware_concurrency()) * 2;
+    size_t loginCount = 2000;
+    uint32_t hashIterations = DEFAULT_HASH_ITERATIONS;
+};
+
+int runLoginBenchmark(const LoginBenchOptions& options) {
+    try {
+        BankingSystem bank(false);
+        bank.setHashIterations(options.hashIterations);
+        unsigned cores = bank.verifierThreads();
+        size_t customerCount = max<size_t>(1, options.customerCount);
+        auto runThreads = [&](auto body) {
+            vector<thread> workers;
+            for (unsigned t = 0; t < options.threadCount; t++) workers.emplace_back(body, t);
+            for (auto& w : workers) w.join();
+        };
+
+        vector<string> ids(customerCount);
+        atomic<size_t> nextCustomer{ 0 }, unexpected{ 0 };
+        auto start = chrono::steady_clock::now();
+        runThreads([&](unsigned) {
+            for (size_t i; (i = nextCustomer.fetch_add(1, memory_order_relaxed)) < customerCount;) {
+                if (bank.openCustomer("login" + to_string(i), "password" + to_string(i), ids[i]) != BankStatus::Ok) unexpected++;
+            }
+        });
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Registered " << customerCount << " customers at " << options.hashIterations << " iterations in "
+            << fixed << setprecision(2) << seconds << " s (" << setprecision(0) << customerCount / max(seconds, 1e-9)
+            << " hashes/sec on " << cores << " verifier threads)" << endl;
+
+        vector<vector<double>> latencies(options.threadCount);
+        vector<string> tokens(options.threadCount);
+        atomic<size_t> nextLogin{ 0 };
+        start = chrono::steady_clock::now();
+        runThreads([&](unsigned index) {
+            for (size_t i; (i = nextLogin.fetch_add(1, memory_order_relaxed)) < options.loginCount;) {
+                size_t customer = i % customerCount;
+                bool wrong = i % 10 == 9;
+                string token;
+                auto begin = chrono::steady_clock::now();
+                BankStatus status = bank.login(ids[customer], wrong ? "wrong" : "password" + to_string(customer), token);
+                latencies[index].push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count());
+                if ((status == BankStatus::Ok) == wrong) unexpected++;
+                if (status == BankStatus::Ok) tokens[index] = token;
             }
+        });
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        vector<double> all;
+        for (auto& samples : latencies) all.insert(all.end(), samples.begin(), samples.end());
+        sort(all.begin(), all.end());
+        double loginsPerSec = options.loginCount / max(seconds, 1e-9);
+        cout << "Logins: " << options.loginCount << " from " << options.threadCount << " threads in "
+            << setprecision(2) << seconds << " s (" << setprecision(0) << loginsPerSec << " logins/sec, "
+            << setprecision(1) << loginsPerSec / cores << " per core)" << endl;
+        cout << setprecision(2) << "Login latency (ms): p50 " << percentile(all, 50) << ", p99 " << percentile(all, 99)
+            << ", max " << (all.empty() ? 0 : all.back()) << endl;
+
+        // Follow-up actions present the session token instead of the password
+        const size_t CHECKS_PER_THREAD = 100000;
+        start = chrono::steady_clock::now();
+        runThreads([&](unsigned index) {
+            string customerId;
+            for (size_t i = 0; i < CHECKS_PER_THREAD && !tokens[index].empty(); i++) {
+                if (bank.checkSession(tokens[index], customerId) != BankStatus::Ok) unexpected++;
+            }
+        });
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Session checks: " << setprecision(0) << CHECKS_PER_THREAD * options.threadCount / max(seconds, 1e-9)
+            << " checks/sec" << endl;
+
+        if (unexpected > 0) {
+            cout << LIGHT_RED << "FAIL: " << unexpected << " registrations, logins or session checks had the wrong outcome" << RESET << endl;
+            return 1;
+        }
+    }
+    catch (const exception& e) {
+        cerr << LIGHT_RED << "Error: " << e.what() << RESET << endl;
+        return 1;
+    }
+    return 0;
+}
+
+void printUsage(const char* program) {
+    cout << "Usage:\n"
+        << "  " << program << "                        Interactive mode\n"
+        << "  " << program << " --stress [--accounts N] [--threads N] [--transfers N] [--durable]\n"
+        << "      Run N random concurrent transfers (default 2000000 over 1000 accounts)\n"
+        << "      and check that the total balance is unchanged; --durable runs them\n"
+        << "      through the write-ahead log in a scratch directory and restarts\n"
+        << "  " << program << " --batch [file|-] [--quiet] [--hash-iterations N]\n"
+        << "      Run one command per line (REGISTER name password, LOGIN id password,\n"
+        << "      SESSION token, DEPOSIT account amount, WITHDRAW account amount,\n"
+        << "      TRANSFER from to amount, BALANCE account, HISTORY account [limit] [cursor])\n"
+        << "      against the bank files in the current directory, print each status\n"
+        << "      and report ops/sec and latency percentiles on stderr\n"
+        << "  " << program << " --convert-ledger [transactions.txt] [ledger.col]\n"
+        << "      Write the text ledger as a columnar binary file with dictionary-encoded\n"
+        << "      account numbers\n"
+        << "  " << program << " --report [ledger.col] [--account ACCOUNT] [--top N]\n"
+        << "      Scan a columnar ledger for daily volume, the top senders and, with\n"
+        << "      --account, that account's totals and top counterparties\n"
+        << "  " << program << " [MODE] --metrics FILE\n"
+        << "      Write operation counters, latency histograms and file I/O trace spans in\n"
+        << "      Prometheus text format to FILE ('-' for stdout) on exit; BANK_TRACE=1\n"
+        << "      also prints every span to stderr as it finishes\n"
+        << "  " << program << " --bench [--customers N] [--threads N] [--ops N] [--mix D,W,T,B]\n"
+        << "          [--durable] [--load-sizes N,N,...] [--csv FILE] [--baseline FILE] [--tolerance PERCENT]\n"
+        << "      Register N customers (default 10000), run N operations (default 1000000)\n"
+        << "      with the given deposit/withdraw/transfer/balance weights, time loading\n"
+        << "      10k, 1M and 10M records, write a CSV (default bank_bench.csv) and exit\n"
+        << "      with 3 if any throughput fell by more than the tolerance (default 20%);\n"
+        << "      passwords are hashed at 1000 iterations unless --hash-iterations is given\n"
+        << "  " << program << " --login-bench [--customers N] [--threads N] [--logins N] [--hash-iterations N]\n"
+        << "      Register N customers (default 200) and run N logins (default 2000) through\n"
+        << "      the password verifier pool, reporting logins/sec per core and session\n"
+        << "      checks/sec; passwords are hashed at 20000 iterations by default\n";
+}
+
+int main(int argc, char* argv[]) {
+    string metricsPath;  // Dump metrics here on exit
+    if (argc > 1) {
+        StressOptions stress;
+        BatchOptions batch;
+        ReportOptions report;
+        BankBenchOptions bench;
+        LoginBenchOptions loginBench;
+        bool benchmark = false, loginBenchmark = false;
+        bool stressTest = false, batchMode = false, convertLedger = false, ledgerReport = false;
+        // Checked option values; the first bad one is reported after the loop
+        string badValue;
+        auto countValue = [&](const string& text) {
+            size_t value = 0;
+            if (!parseCount(text, value) && badValue.empty()) badValue = text;
+            return value;
+        };
+        auto decimalValue = [&](const string& text) {
+            double value = 0;
+            if (!parseDecimal(text, value) && badValue.empty()) badValue = text;
+            return value;
+        };
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--stress") {
+                stressTest = true;
+            }
+            else if (arg == "--batch") {
+                batchMode = true;
+                if (i + 1 < argc && string(argv[i + 1]).rfind("--", 0) != 0) batch.inputPath = argv[++i];
+            }
+            else if (arg == "--convert-ledger") {
+                convertLedger = true;
+                if (i + 1 < argc && string(argv[i + 1]).rfind("--", 0) != 0) report.textPath = argv[++i];
+                if (i + 1 < argc && string(argv[i + 1]).rfind("--", 0) != 0) report.ledgerPath = argv[++i];
+            }
+            else if (arg == "--report") {
+                ledgerReport = true;
+                if (i + 1 < argc && string(argv[i + 1]).rfind("--", 0) != 0) report.ledgerPath = argv[++i];
+            }
+            else if (arg == "--account" && i + 1 < argc) {
+                report.account = argv[++i];
+            }
+            else if (arg == "--top" && i + 1 < argc) {
+                report.top = countValue(argv[++i]);
+            }
+            else if (arg == "--metrics" && i + 1 < argc) {
+                metricsPath = argv[++i];
+            }
+            else if (arg == "--quiet") {
+                batch.quiet = true;
+            }
+            else if (arg == "--accounts" && i + 1 < argc) {
+                stress.accountCount = max<size_t>(2, countValue(argv[++i]));
+            }
+            else if (arg == "--threads" && i + 1 < argc) {
+                stress.threadCount = bench.threadCount = loginBench.threadCount = max(1u, static_cast<unsigned>(min<size_t>(countValue(argv[++i]), 4096)));
+            }
+            else if (arg == "--transfers" && i + 1 < argc) {
+                stress.transferCount = countValue(argv[++i]);
+            }
+            else if (arg == "--durable") {
+                stress.durable = bench.durable = true;
+            }
+            else if (arg == "--bench") {
+                benchmark = true;
+            }
+            else if (arg == "--customers" && i + 1 < argc) {
+                bench.customerCount = loginBench.customerCount = countValue(argv[++i]);
+            }
+            else if (arg == "--login-bench") {
+                loginBenchmark = true;
+            }
+            else if (arg == "--logins" && i + 1 < argc) {
+                loginBench.loginCount = countValue(argv[++i]);
+            }
+            else if (arg == "--hash-iterations" && i + 1 < argc) {
+                uint32_t iterations = max(1u, static_cast<uint32_t>(min<size_t>(countValue(argv[++i]), UINT32_MAX)));
+                batch.hashIterations = bench.hashIterations = loginBench.hashIterations = iterations;
+            }
+            else if (arg == "--ops" && i + 1 < argc) {
+                bench.operationCount = countValue(argv[++i]);
+            }
+            else if (arg == "--mix" && i + 1 < argc) {
+                stringstream weights(argv[++i]);
+                string weight;
+                for (size_t k = 0; k < bench.mix.size(); k++) {
+                    bench.mix[k] = getline(weights, weight, ',') ? static_cast<unsigned>(min<size_t>(countValue(weight), UINT32_MAX)) : 0;
+                }
+            }
+            else if (arg == "--load-sizes" && i + 1 < argc) {
+                stringstream sizes(argv[++i]);
+                string size;
+                bench.loadSizes.clear();
+                while (getline(sizes, size, ',')) {
+                    if (!size.empty()) bench.loadSizes.push_back(countValue(size));
+                }
+            }
+            else if (arg == "--csv" && i + 1 < argc) {
+                bench.csvPath = argv[++i];
+            }
+            else if (arg == "--baseline" && i + 1 < argc) {
+                bench.baselinePath = argv[++i];
+            }
+            else if (arg == "--tolerance" && i + 1 < argc) {
+                bench.tolerance = decimalValue(argv[++i]);
+            }
+            else {
+                printUsage(argv[0]);
+                return arg == "--help" ? 0 : 1;
+            }
+        }
+        if (!badValue.empty()) {
+            cerr << LIGHT_RED << "Not a valid number: " << badValue << RESET << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        int result = -1;
+        try {
+            if (stressTest) result = runStressTest(stress);
+            else if (benchmark) result = runBankBenchmark(bench);
+            else if (loginBenchmark) result = runLoginBenchmark(loginBench);
+            else if (batchMode) result = runBatch(batch);
+            else if (convertLedger) result = runConvertLedger(report);
+            else if (ledgerReport) result = runLedgerReport(report);
+            else if (metricsPath.empty()) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        catch (const exception& e) {
+            cerr << LIGHT_RED << "Error: " << e.what() << RESET << endl;
+            result = 1;
+        }
+        if (result >= 0) {
+            if (!metricsPath.empty() && !bankMetrics.dump(metricsPath)) {
+                cerr << LIGHT_RED << "Unable to write metrics to " << metricsPath << RESET << endl;
+            }
+            return result;
+        }
+    }
+
+    try {
+        {
+            BankingSystem bankSystem;
+            int choice;
+            bool exiting = false;
+            while (!exiting) {
+                cout << "\n===== Banking System =====" << endl;
+                cout << "1. Register" << endl;
+                cout << "2. Login" << endl;
+                cout << "3. Exit" << endl;
+                cout << LIGHT_YELLOW << "Select an option: " << RESET;
+                cin >> choice;
+                cin.ignore();  // Discard any leftover newline character
+
+                switch (choice) {
+                case 1:
+                    bankSystem.registerCustomer();
+                    break;
+                case 2:
+                    bankSystem.loginCustomer();
+                    break;
+                case 3:
+                    cout << "Exiting system..." << endl;
+                    exiting = true;
+                    break;
+                default:
+                    cout << LIGHT_RED << "Invalid choice!" << RESET << endl;
+                }
+            }
+        }
+        if (!metricsPath.empty() && !bankMetrics.dump(metricsPath)) {
+            cout << LIGHT_RED << "Unable to write metrics to " << metricsPath << RESET << endl;
         }
     }
     catch (const exception& e) {
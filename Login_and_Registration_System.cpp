@@ -1,14 +1,53 @@
 #include <iostream> 
 #include <fstream>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <deque>
+#include <memory>
 #include <algorithm>
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <csignal>
+#include <fcntl.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LOGIN_X86 1
+#endif
 
 #ifdef _WIN32
 #include <conio.h>
+#include <io.h>
 #else
 #include <termios.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #endif
 
 using namespace std;
@@ -60,141 +99,2493 @@ string getPasswordInput(const string& prompt) {
     return password;
 }
 
-class UserManager {
+// ---------- File helpers ----------
+
+int openFile(const string& path, int flags) {
+#ifdef _WIN32
+    return _open(path.c_str(), flags | _O_BINARY, 0644);
+#else
+    return ::open(path.c_str(), flags, 0644);
+#endif
+}
+
+void closeFile(int handle) {
+#ifdef _WIN32
+    _close(handle);
+#else
+    ::close(handle);
+#endif
+}
+
+uint64_t fileSize(int handle) {
+#ifdef _WIN32
+    return static_cast<uint64_t>(_lseeki64(handle, 0, SEEK_END));
+#else
+    return static_cast<uint64_t>(lseek(handle, 0, SEEK_END));
+#endif
+}
+
+// Positioned reads and writes; on Windows these seek first, so callers must
+// not share a handle between threads there
+bool readAt(int handle, uint64_t offset, void* data, size_t length) {
+    char* bytes = static_cast<char*>(data);
+    while (length > 0) {
+#ifdef _WIN32
+        if (_lseeki64(handle, static_cast<__int64>(offset), SEEK_SET) < 0) return false;
+        int n = _read(handle, bytes, static_cast<unsigned>(length));
+#else
+        ssize_t n = pread(handle, bytes, length, static_cast<off_t>(offset));
+#endif
+        if (n <= 0) return false;
+        bytes += n;
+        offset += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool writeAt(int handle, uint64_t offset, const void* data, size_t length) {
+    const char* bytes = static_cast<const char*>(data);
+    while (length > 0) {
+#ifdef _WIN32
+        if (_lseeki64(handle, static_cast<__int64>(offset), SEEK_SET) < 0) return false;
+        int n = _write(handle, bytes, static_cast<unsigned>(length));
+#else
+        ssize_t n = pwrite(handle, bytes, length, static_cast<off_t>(offset));
+#endif
+        if (n <= 0) return false;
+        bytes += n;
+        offset += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// ---------- User store ----------
+// Every user lives in one append-only file, users.dat, one record per line:
+//   <username>\t<stored password>\n
+// A later record for the same username replaces the earlier one. users.idx is
+// an open-addressing hash table over it: a 40-byte header followed by one
+// slot per bucket with the username's hash and the offset and length of its
+// newest record. The index is loaded whole at startup and updated in place
+// slot by slot, so a lookup is one probe in memory plus one read of the
+// record. Records past the bytes the header covers (a crash between the two
+// writes) are indexed on load, and a missing or damaged index is rebuilt
+// from users.dat.
+
+class UserStore {
 private:
-    string toLower(const string& str) {
-        string lowered = str;
-        transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
-        return lowered;
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t slotCount;
+        uint64_t userCount;
+        uint64_t dataBytes;  // Length of users.dat the slots cover
+        uint64_t reserved;
+    };
+
+    struct Slot {
+        uint64_t hash;
+        uint64_t offset;
+        uint32_t length;  // Record length including the newline; 0 marks an empty slot
+        uint32_t reserved;
+    };
+
+    static const uint32_t INDEX_MAGIC = 0x58445355u;  // "USDX"
+    static const uint32_t INDEX_VERSION = 1;
+
+    string dataPath;
+    string indexPath;
+    int dataFile = -1;
+    int indexFile = -1;
+    Header header{};
+    vector<Slot> slots;
+    bool indexStale = false;  // putBatch() left users.idx behind the slots in memory
+
+public:
+    static uint64_t hashName(string_view username) {
+        uint64_t h = 14695981039346656037ull;  // FNV-1a, then a final mix so every bit depends on every byte
+        for (unsigned char ch : username) {
+            h ^= ch;
+            h *= 1099511628211ull;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return h;
+    }
+
+private:
+    bool readRecord(const Slot& slot, string& username, string& password) const {
+        string record(slot.length, '\0');
+        if (!readAt(dataFile, slot.offset, &record[0], record.size())) {
+            throw runtime_error("Unable to read " + dataPath + ".");
+        }
+        size_t tab = record.find('\t');
+        if (tab == string::npos || record.back() != '\n') return false;
+        username = record.substr(0, tab);
+        password = record.substr(tab + 1, record.size() - tab - 2);
+        return true;
+    }
+
+    // Bucket holding username, or the empty bucket where it would go
+    size_t probe(uint64_t hash, string_view username, bool& found) const {
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        found = false;
+        string storedUser, storedPass;
+        while (slots[i].length != 0) {
+            if (slots[i].hash == hash && readRecord(slots[i], storedUser, storedPass) && storedUser == username) {
+                found = true;
+                return i;
+            }
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    // Point username's slot at a record; returns the bucket, or SIZE_MAX if
+    // the table had to grow (every bucket moved)
+    size_t place(string_view username, uint64_t offset, uint32_t length) {
+        uint64_t hash = hashName(username);
+        bool found;
+        size_t i = probe(hash, username, found);
+        slots[i] = Slot{ hash, offset, length, 0 };
+        if (found) return i;
+        header.userCount++;
+        if (header.userCount * 2 <= slots.size()) return i;
+
+        vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.length == 0) continue;
+            size_t j = slot.hash & mask;
+            while (slots[j].length != 0) j = (j + 1) & mask;
+            slots[j] = slot;
+        }
+        return SIZE_MAX;
+    }
+
+    // Index every complete record of users.dat from offset on, dropping a
+    // torn last line
+    void indexRecords(uint64_t offset) {
+        uint64_t size = fileSize(dataFile);
+        vector<char> buffer(1 << 20);
+        string pending;
+        uint64_t recordStart = offset;
+        while (offset < size) {
+            size_t chunk = static_cast<size_t>(min<uint64_t>(buffer.size(), size - offset));
+            if (!readAt(dataFile, offset, buffer.data(), chunk)) throw runtime_error("Unable to read " + dataPath + ".");
+            offset += chunk;
+            pending.append(buffer.data(), chunk);
+
+            size_t lineStart = 0, newline;
+            while ((newline = pending.find('\n', lineStart)) != string::npos) {
+                string_view line(pending.data() + lineStart, newline - lineStart);
+                size_t tab = line.find('\t');
+                if (tab != string_view::npos && tab > 0) {
+                    place(line.substr(0, tab), recordStart, static_cast<uint32_t>(line.size() + 1));
+                }
+                recordStart += line.size() + 1;
+                lineStart = newline + 1;
+            }
+            pending.erase(0, lineStart);
+        }
+        if (recordStart < size) {
+            closeFile(dataFile);
+            filesystem::resize_file(dataPath, recordStart);
+            dataFile = openFile(dataPath, O_RDWR);
+            if (dataFile < 0) throw runtime_error("Unable to open " + dataPath + ".");
+        }
+        header.dataBytes = recordStart;
     }
 
-    void createUsersFolder() {
-        system("mkdir users >nul 2>&1");
+    bool loadIndex() {
+        int file = openFile(indexPath, O_RDONLY);
+        if (file < 0) return false;
+        uint64_t size = fileSize(file);
+        bool ok = size >= sizeof(Header) && readAt(file, 0, &header, sizeof(Header))
+            && header.magic == INDEX_MAGIC && header.version == INDEX_VERSION
+            && header.slotCount >= 16 && (header.slotCount & (header.slotCount - 1)) == 0
+            && size == sizeof(Header) + header.slotCount * sizeof(Slot)
+            && header.dataBytes <= fileSize(dataFile);
+        if (ok) {
+            slots.resize(header.slotCount);
+            ok = readAt(file, sizeof(Header), slots.data(), slots.size() * sizeof(Slot));
+        }
+        closeFile(file);
+        return ok;
     }
 
-    bool fileExists(const string& filename) {
-        ifstream f(filename.c_str());
-        return f.good();
+    // Write the whole index to a temp file and rename it into place
+    void writeIndex() {
+        if (indexFile >= 0) closeFile(indexFile);
+        indexFile = -1;
+        header.slotCount = slots.size();
+        string temp = indexPath + ".tmp";
+        int file = openFile(temp, O_WRONLY | O_CREAT | O_TRUNC);
+        bool ok = file >= 0 && writeAt(file, 0, &header, sizeof(Header))
+            && writeAt(file, sizeof(Header), slots.data(), slots.size() * sizeof(Slot));
+        if (file >= 0) closeFile(file);
+        if (!ok) throw runtime_error("Unable to write " + temp + ".");
+        filesystem::rename(temp, indexPath);
+        indexFile = openFile(indexPath, O_RDWR);
+        if (indexFile < 0) throw runtime_error("Unable to open " + indexPath + ".");
     }
 
 public:
-    void registerUser() {
-        string username, password, confirmPass;
-        cout << CYAN << "\n[User Registration]\n" << RESET;
+    explicit UserStore(const string& dataPath = "users.dat", const string& indexPath = "users.idx")
+        : dataPath(dataPath), indexPath(indexPath) {
+        dataFile = openFile(dataPath, O_RDWR | O_CREAT);
+        if (dataFile < 0) throw runtime_error("Unable to open " + dataPath + ".");
 
-        cout << "Enter username: ";
-        cin >> username;
-        username = toLower(username);
-        string filePath = "users/" + username + ".txt";
+        uint64_t covered = 0;
+        if (loadIndex()) {
+            covered = header.dataBytes;
+        }
+        else {
+            header = Header{ INDEX_MAGIC, INDEX_VERSION, 0, 0, 0, 0 };
+            slots.assign(16, Slot{});
+        }
+        indexRecords(covered);
+        if (covered == 0 || header.dataBytes != covered || header.slotCount != slots.size()) {
+            writeIndex();
+        }
+        else {
+            indexFile = openFile(indexPath, O_RDWR);
+            if (indexFile < 0) throw runtime_error("Unable to open " + indexPath + ".");
+        }
+    }
 
-        if (fileExists(filePath)) {
-            cout << RED << "Username already exists. Try another.\n" << RESET;
-            return;
+    ~UserStore() {
+        try {
+            flushIndex();
         }
+        catch (const exception&) {
+            // users.idx stays behind; the next start indexes the tail again
+        }
+        if (dataFile >= 0) closeFile(dataFile);
+        if (indexFile >= 0) closeFile(indexFile);
+    }
 
-        cin.ignore(); // Clear buffer
-        password = getPasswordInput("Enter password: ");
-        confirmPass = getPasswordInput("Confirm password: ");
+    UserStore(const UserStore&) = delete;
+    UserStore& operator=(const UserStore&) = delete;
 
-        if (password != confirmPass) {
-            cout << RED << "Passwords do not match.\n" << RESET;
-            return;
+    size_t size() const {
+        return static_cast<size_t>(header.userCount);
+    }
+
+    // Call fn with hashName() of every username, straight from the index
+    template <typename Fn>
+    void forEachHash(Fn fn) const {
+        for (const Slot& slot : slots) {
+            if (slot.length != 0) fn(slot.hash);
         }
+    }
 
-        createUsersFolder();
+    bool find(const string& username, string& password) const {
+        uint64_t hash = hashName(username);
+        bool found;
+        size_t i = probe(hash, username, found);
+        if (!found) return false;
+        string storedUser;
+        return readRecord(slots[i], storedUser, password);
+    }
 
-        try {
-            ofstream file(filePath);
-            if (!file) throw runtime_error("Could not create user file.");
+    bool contains(const string& username) const {
+        string password;
+        return find(username, password);
+    }
 
-            file << username << endl;
-            file << password << endl;
-            file.close();
+    // Append a record for username (replacing any earlier one) and index it
+    void put(const string& username, const string& password) {
+        if (username.empty() || username.find_first_of("\t\n\r") != string::npos
+            || password.find_first_of("\t\n\r") != string::npos) {
+            throw runtime_error("Usernames and passwords cannot contain tabs or line breaks.");
+        }
+        string record = username + '\t' + password + '\n';
+        uint64_t offset = header.dataBytes;
+        if (!writeAt(dataFile, offset, record.data(), record.size())) {
+            throw runtime_error("Unable to write " + dataPath + ".");
+        }
+        header.dataBytes += record.size();
 
-            cout << GREEN << "User registered successfully!\n" << RESET;
+        size_t bucket = place(username, offset, static_cast<uint32_t>(record.size()));
+        if (bucket == SIZE_MAX || indexStale) {
+            writeIndex();
+            indexStale = false;
+            return;
         }
-        catch (const exception& e) {
-            cout << RED << "Registration failed: " << e.what() << RESET << endl;
+        bool ok = writeAt(indexFile, sizeof(Header) + bucket * sizeof(Slot), &slots[bucket], sizeof(Slot))
+            && writeAt(indexFile, 0, &header, sizeof(Header));
+        if (!ok) throw runtime_error("Unable to write " + indexPath + ".");
+    }
+
+    // Append many records with one write. users.idx is brought up to date
+    // by flushIndex() (or the next put()); until then a restart finds the
+    // records past the covered length and indexes them from users.dat.
+    void putBatch(const vector<string>& usernames, const vector<string>& passwords) {
+        string records;
+        vector<uint32_t> lengths;
+        lengths.reserve(usernames.size());
+        for (size_t i = 0; i < usernames.size(); i++) {
+            if (usernames[i].empty() || usernames[i].find_first_of("\t\n\r") != string::npos
+                || passwords[i].find_first_of("\t\n\r") != string::npos) {
+                throw runtime_error("Usernames and passwords cannot contain tabs or line breaks.");
+            }
+            size_t before = records.size();
+            records += usernames[i];
+            records += '\t';
+            records += passwords[i];
+            records += '\n';
+            lengths.push_back(static_cast<uint32_t>(records.size() - before));
+        }
+        uint64_t offset = header.dataBytes;
+        if (!writeAt(dataFile, offset, records.data(), records.size())) {
+            throw runtime_error("Unable to write " + dataPath + ".");
+        }
+        for (size_t i = 0; i < usernames.size(); i++) {
+            place(usernames[i], offset, lengths[i]);
+            offset += lengths[i];
         }
+        header.dataBytes = offset;
+        indexStale = true;
     }
 
-    void loginUser() {
-        string username, password;
-        cout << CYAN << "\n[User Login]\n" << RESET;
+    void flushIndex() {
+        if (!indexStale) return;
+        writeIndex();
+        indexStale = false;
+    }
 
-        cout << "Enter username: ";
-        cin >> username;
-        username = toLower(username);
-        string filePath = "users/" + username + ".txt";
+    // Call fn(username, password) for the newest record of every user, in
+    // users.dat order, reading the file sequentially
+    template <typename Fn>
+    void forEachRecord(Fn fn) const {
+        uint64_t size = header.dataBytes, offset = 0, recordStart = 0;
+        vector<char> buffer(1 << 20);
+        string pending;
+        size_t mask = slots.size() - 1;
+        while (offset < size) {
+            size_t chunk = static_cast<size_t>(min<uint64_t>(buffer.size(), size - offset));
+            if (!readAt(dataFile, offset, buffer.data(), chunk)) throw runtime_error("Unable to read " + dataPath + ".");
+            offset += chunk;
+            pending.append(buffer.data(), chunk);
 
-        if (!fileExists(filePath)) {
-            cout << RED << "Account does not exist.\n" << RESET;
-            return;
+            size_t lineStart = 0, newline;
+            while ((newline = pending.find('\n', lineStart)) != string::npos) {
+                string_view line(pending.data() + lineStart, newline - lineStart);
+                size_t tab = line.find('\t');
+                if (tab != string_view::npos && tab > 0) {
+                    // Current when the username's slot points at this very record
+                    string_view username = line.substr(0, tab);
+                    uint64_t hash = hashName(username);
+                    size_t i = hash & mask;
+                    while (slots[i].length != 0 && !(slots[i].hash == hash && slots[i].offset == recordStart)) {
+                        i = (i + 1) & mask;
+                    }
+                    if (slots[i].length != 0) fn(username, line.substr(tab + 1));
+                }
+                recordStart += line.size() + 1;
+                lineStart = newline + 1;
+            }
+            pending.erase(0, lineStart);
         }
+    }
+};
 
-        cin.ignore(); // Clear buffer
-        password = getPasswordInput("Enter password: ");
+// ---------- Password hashing ----------
+// Passwords are stored as
+//   pbkdf2-sha256$<iterations>$<salt hex>$<key hex>
+// (PBKDF2-HMAC-SHA256 from RFC 8018 with a 16-byte random salt and a 32-byte
+// key). Records from before hashing hold the plaintext; they still verify
+// and are rehashed on the user's next successful login.
+//
+// Almost all the work is the iterated rounds, and every round of every
+// password is the same two SHA-256 blocks over different data, so the
+// rounds run in lanes: the AVX2 kernel advances eight passwords at once in
+// the 32-bit lanes of each register, and the scalar kernel does one at a
+// time. The kernel is picked by CPU detection; --kernel overrides it.
 
-        try {
-            ifstream file(filePath);
-            if (!file) throw runtime_error("Could not open user file.");
+const char* const PASSWORD_HASH_PREFIX = "pbkdf2-sha256$";
+const uint32_t DEFAULT_HASH_ITERATIONS = 20000;
+const size_t PASSWORD_SALT_BYTES = 16;
+const uint32_t MAX_IMPORT_HASH_ITERATIONS = 1000000;  // Or the configured count, if higher
+
+const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotr32(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+// SHA-256 compression of one block given as 16 big-endian words
+void sha256Compress(uint32_t* h, const uint32_t* message) {
+    uint32_t w[64];
+    memcpy(w, message, 16 * sizeof(uint32_t));
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = k + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+// Streaming SHA-256 for the parts of PBKDF2 whose input length varies
+class Sha256 {
+private:
+    uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    uint8_t block[64];
+    size_t used = 0;
+    uint64_t totalBytes = 0;
 
-            string storedUser, storedPass;
-            getline(file, storedUser);
-            getline(file, storedPass);
+    void compressBlock(const uint8_t* data) {
+        uint32_t words[16];
+        for (int i = 0; i < 16; i++) {
+            words[i] = uint32_t(data[i * 4]) << 24 | uint32_t(data[i * 4 + 1]) << 16 | uint32_t(data[i * 4 + 2]) << 8 | data[i * 4 + 3];
+        }
+        sha256Compress(state, words);
+    }
 
-            if (storedUser == username && storedPass == password) {
-                cout << GREEN << "Login successful. Welcome, " << username << "!\n" << RESET;
+public:
+    void update(const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        totalBytes += length;
+        while (length > 0) {
+            size_t take = min(length, sizeof(block) - used);
+            memcpy(block + used, bytes, take);
+            used += take;
+            bytes += take;
+            length -= take;
+            if (used == sizeof(block)) {
+                compressBlock(block);
+                used = 0;
             }
-            else {
-                cout << RED << "Invalid credentials.\n" << RESET;
+        }
+    }
+
+    // Final hash as eight words
+    void finish(uint32_t* digest) {
+        uint64_t bits = totalBytes * 8;
+        uint8_t padding[72] = { 0x80 };
+        size_t padLength = (used < 56 ? 56 : 120) - used;
+        for (int i = 0; i < 8; i++) padding[padLength + i] = uint8_t(bits >> (56 - 8 * i));
+        update(padding, padLength + 8);
+        memcpy(digest, state, sizeof(state));
+    }
+
+    // State after exactly one block, the HMAC key block
+    const uint32_t* midstate() const {
+        return state;
+    }
+};
+
+// One PBKDF2-HMAC-SHA256 computation with a single 32-byte output block
+struct HashJob {
+    string password;
+    string salt;
+    uint32_t iterations = DEFAULT_HASH_ITERATIONS;
+    uint8_t key[32];
+};
+
+// Iterated part of one job: the HMAC key midstates, the last U and the running XOR
+struct LaneState {
+    uint32_t inner[8];
+    uint32_t outer[8];
+    uint32_t u[8];
+    uint32_t t[8];
+};
+
+// Run rounds more PBKDF2 rounds on count lanes (at most the kernel's width)
+using RoundsKernel = void (*)(LaneState* lanes, size_t count, uint32_t rounds);
+
+// Un = HMAC(password, Un-1): both hashes are one block on top of a key
+// midstate, holding the 32-byte digest and fixed padding for 96 bytes
+void roundsScalar(LaneState* lanes, size_t count, uint32_t rounds) {
+    for (size_t l = 0; l < count; l++) {
+        LaneState& lane = lanes[l];
+        uint32_t message[16] = {};
+        message[8] = 0x80000000;
+        message[15] = (64 + 32) * 8;
+        for (uint32_t round = 0; round < rounds; round++) {
+            uint32_t h[8];
+            memcpy(message, lane.u, sizeof(lane.u));
+            memcpy(h, lane.inner, sizeof(h));
+            sha256Compress(h, message);
+            memcpy(message, h, sizeof(h));
+            memcpy(h, lane.outer, sizeof(h));
+            sha256Compress(h, message);
+            for (int j = 0; j < 8; j++) {
+                lane.u[j] = h[j];
+                lane.t[j] ^= h[j];
             }
         }
-        catch (const exception& e) {
-            cout << RED << "Login error: " << e.what() << RESET << endl;
+    }
+}
+
+#ifdef LOGIN_X86
+__attribute__((target("avx2")))
+inline __m256i rotr8x32(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// sha256Compress() on eight independent blocks, word i of every lane in h[i]
+// and message[i]; message words 8..15 are the fixed round padding
+__attribute__((target("avx2")))
+inline void sha256CompressAvx2(__m256i* h, const __m256i* message) {
+    __m256i w[64];
+    for (int i = 0; i < 8; i++) w[i] = message[i];
+    w[8] = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+    for (int i = 9; i < 15; i++) w[i] = _mm256_setzero_si256();
+    w[15] = _mm256_set1_epi32((64 + 32) * 8);
+    for (int i = 16; i < 64; i++) {
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr8x32(w[i - 15], 7), rotr8x32(w[i - 15], 18)), _mm256_srli_epi32(w[i - 15], 3));
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr8x32(w[i - 2], 17), rotr8x32(w[i - 2], 19)), _mm256_srli_epi32(w[i - 2], 10));
+        w[i] = _mm256_add_epi32(_mm256_add_epi32(w[i - 16], s0), _mm256_add_epi32(w[i - 7], s1));
+    }
+    __m256i a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for (int i = 0; i < 64; i++) {
+        __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(rotr8x32(e, 6), rotr8x32(e, 11)), rotr8x32(e, 25));
+        __m256i choose = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(k, sigma1),
+            _mm256_add_epi32(choose, _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(SHA256_K[i])), w[i])));
+        __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(rotr8x32(a, 2), rotr8x32(a, 13)), rotr8x32(a, 22));
+        __m256i majority = _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(a, c)), _mm256_and_si256(b, c));
+        __m256i t2 = _mm256_add_epi32(sigma0, majority);
+        k = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+        d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+    }
+    h[0] = _mm256_add_epi32(h[0], a); h[1] = _mm256_add_epi32(h[1], b);
+    h[2] = _mm256_add_epi32(h[2], c); h[3] = _mm256_add_epi32(h[3], d);
+    h[4] = _mm256_add_epi32(h[4], e); h[5] = _mm256_add_epi32(h[5], f);
+    h[6] = _mm256_add_epi32(h[6], g); h[7] = _mm256_add_epi32(h[7], k);
+}
+
+// roundsScalar() for up to eight lanes at once; unused lanes compute garbage
+__attribute__((target("avx2")))
+void roundsAvx2(LaneState* lanes, size_t count, uint32_t rounds) {
+    alignas(32) uint32_t column[8] = {};
+    __m256i inner[8], outer[8], u[8], t[8];
+    for (int j = 0; j < 8; j++) {
+        for (size_t l = 0; l < count; l++) column[l] = lanes[l].inner[j];
+        inner[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(column));
+        for (size_t l = 0; l < count; l++) column[l] = lanes[l].outer[j];
+        outer[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(column));
+        for (size_t l = 0; l < count; l++) column[l] = lanes[l].u[j];
+        u[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(column));
+        for (size_t l = 0; l < count; l++) column[l] = lanes[l].t[j];
+        t[j] = _mm256_load_si256(reinterpret_cast<const __m256i*>(column));
+    }
+    for (uint32_t round = 0; round < rounds; round++) {
+        __m256i h[8];
+        for (int j = 0; j < 8; j++) h[j] = inner[j];
+        sha256CompressAvx2(h, u);
+        for (int j = 0; j < 8; j++) u[j] = h[j];
+        for (int j = 0; j < 8; j++) h[j] = outer[j];
+        sha256CompressAvx2(h, u);
+        for (int j = 0; j < 8; j++) {
+            u[j] = h[j];
+            t[j] = _mm256_xor_si256(t[j], h[j]);
         }
     }
+    for (int j = 0; j < 8; j++) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(column), t[j]);
+        for (size_t l = 0; l < count; l++) lanes[l].t[j] = column[l];
+    }
+}
+#endif
+
+struct HashKernel {
+    const char* name;
+    RoundsKernel fn;
+    size_t lanes;
 };
 
-void clearInput() {
-    cin.clear();
-    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+HashKernel detectHashKernel() {
+#ifdef LOGIN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return { "avx2", roundsAvx2, 8 };
+#endif
+    return { "scalar", roundsScalar, 1 };
 }
 
-void displayMenu() {
-    cout << YELLOW << "\n========= Welcome to Secure Login System =========\n" << RESET;
-    cout << "1. Register a New User\n";
-    cout << "2. Login\n";
-    cout << "3. Exit\n";
-    cout << CYAN << "Choose an option: " << RESET;
+HashKernel& activeHashKernel() {
+    static HashKernel kernel = detectHashKernel();
+    return kernel;
+}
+
+// Force a kernel ("scalar" or "avx2"); false if unknown or unsupported
+bool selectHashKernel(const string& name) {
+    if (name == "scalar") {
+        activeHashKernel() = { "scalar", roundsScalar, 1 };
+        return true;
+    }
+#ifdef LOGIN_X86
+    if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+        activeHashKernel() = { "avx2", roundsAvx2, 8 };
+        return true;
+    }
+#endif
+    return false;
 }
 
-int main() {
-    UserManager userManager;
-    int choice;
+// Key midstates and U1 = HMAC(password, salt || INT(1)) for one job
+void startJob(const HashJob& job, LaneState& lane) {
+    uint8_t key[64] = {};
+    if (job.password.size() > sizeof(key)) {
+        // Keys longer than a block are hashed first
+        Sha256 longKey;
+        longKey.update(job.password.data(), job.password.size());
+        uint32_t digest[8];
+        longKey.finish(digest);
+        for (int i = 0; i < 32; i++) key[i] = uint8_t(digest[i / 4] >> (24 - 8 * (i % 4)));
+    }
+    else {
+        memcpy(key, job.password.data(), job.password.size());
+    }
+    uint8_t pad[64];
+    Sha256 inner, outer;
+    for (size_t i = 0; i < sizeof(pad); i++) pad[i] = key[i] ^ 0x36;
+    inner.update(pad, sizeof(pad));
+    for (size_t i = 0; i < sizeof(pad); i++) pad[i] = key[i] ^ 0x5c;
+    outer.update(pad, sizeof(pad));
+    memcpy(lane.inner, inner.midstate(), sizeof(lane.inner));
+    memcpy(lane.outer, outer.midstate(), sizeof(lane.outer));
 
-    while (true) {
-        displayMenu();
+    const uint8_t blockIndex[4] = { 0, 0, 0, 1 };
+    inner.update(job.salt.data(), job.salt.size());
+    inner.update(blockIndex, sizeof(blockIndex));
+    inner.finish(lane.u);
+    uint8_t innerDigest[32];
+    for (int i = 0; i < 32; i++) innerDigest[i] = uint8_t(lane.u[i / 4] >> (24 - 8 * (i % 4)));
+    outer.update(innerDigest, sizeof(innerDigest));
+    outer.finish(lane.u);
+    memcpy(lane.t, lane.u, sizeof(lane.t));
+}
 
-        if (!(cin >> choice)) {
-            cout << RED << "Please enter a valid numeric option.\n" << RESET;
-            clearInput();
-            continue;
+// Run every job, filling the kernel's lanes with jobs of equal iteration count
+void pbkdf2Batch(HashJob* const* jobs, size_t count, const HashKernel& kernel = activeHashKernel()) {
+    vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++) order[i] = i;
+    stable_sort(order.begin(), order.end(), [jobs](size_t a, size_t b) { return jobs[a]->iterations < jobs[b]->iterations; });
+
+    vector<LaneState> lanes(kernel.lanes);
+    for (size_t start = 0; start < count;) {
+        uint32_t iterations = max(1u, jobs[order[start]]->iterations);
+        size_t used = 0;
+        while (used < kernel.lanes && start + used < count && max(1u, jobs[order[start + used]]->iterations) == iterations) {
+            startJob(*jobs[order[start + used]], lanes[used]);
+            used++;
+        }
+        kernel.fn(lanes.data(), used, iterations - 1);
+        for (size_t l = 0; l < used; l++) {
+            HashJob& job = *jobs[order[start + l]];
+            for (int i = 0; i < 32; i++) job.key[i] = uint8_t(lanes[l].t[i / 4] >> (24 - 8 * (i % 4)));
         }
+        start += used;
+    }
+}
 
-        switch (choice) {
-        case 1:
-            userManager.registerUser();
-            break;
-        case 2:
-            userManager.loginUser();
-            break;
-        case 3:
-            cout << CYAN << "Thank you for using the system. Goodbye!\n" << RESET;
-            return 0;
-        default:
-            cout << RED << "Invalid option. Try again.\n" << RESET;
+string hexEncode(const uint8_t* bytes, size_t length) {
+    static const char DIGITS[] = "0123456789abcdef";
+    string hex(length * 2, '0');
+    for (size_t i = 0; i < length; i++) {
+        hex[i * 2] = DIGITS[bytes[i] >> 4];
+        hex[i * 2 + 1] = DIGITS[bytes[i] & 0xf];
+    }
+    return hex;
+}
+
+bool hexDecode(string_view hex, string& bytes) {
+    auto digit = [](char ch) {
+        if (ch >= '0' && ch <= '9') return ch - '0';
+        if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+        return -1;
+    };
+    if (hex.size() % 2 != 0) return false;
+    bytes.resize(hex.size() / 2);
+    for (size_t i = 0; i < bytes.size(); i++) {
+        int high = digit(hex[i * 2]), low = digit(hex[i * 2 + 1]);
+        if (high < 0 || low < 0) return false;
+        bytes[i] = static_cast<char>(high << 4 | low);
+    }
+    return true;
+}
+
+string randomBytes(size_t count) {
+    thread_local random_device device;
+    string bytes(count, '\0');
+    for (size_t i = 0; i < count; i += 4) {
+        uint32_t value = device();
+        memcpy(&bytes[i], &value, min<size_t>(4, count - i));
+    }
+    return bytes;
+}
+
+// Equality whose running time depends only on the lengths
+bool constantTimeEquals(string_view a, string_view b) {
+    unsigned char difference = a.size() != b.size();
+    size_t length = min(a.size(), b.size());
+    for (size_t i = 0; i < length; i++) difference |= a[i] ^ b[i];
+    return difference == 0;
+}
+
+bool isPasswordHash(string_view stored) {
+    return stored.substr(0, strlen(PASSWORD_HASH_PREFIX)) == PASSWORD_HASH_PREFIX;
+}
+
+string formatCredential(const HashJob& job) {
+    return PASSWORD_HASH_PREFIX + to_string(job.iterations) + "$"
+        + hexEncode(reinterpret_cast<const uint8_t*>(job.salt.data()), job.salt.size()) + "$"
+        + hexEncode(job.key, sizeof(job.key));
+}
+
+// Iterations, salt and key hex of a stored hash
+bool parseCredential(string_view stored, HashJob& job, string_view& keyHex) {
+    string_view fields = stored.substr(strlen(PASSWORD_HASH_PREFIX));
+    size_t saltStart = fields.find('$');
+    size_t keyStart = saltStart == string_view::npos ? saltStart : fields.find('$', saltStart + 1);
+    if (keyStart == string_view::npos) return false;
+    string count(fields.substr(0, saltStart));
+    if (count.empty() || count.size() > 9 || count.find_first_not_of("0123456789") != string::npos) return false;
+    job.iterations = static_cast<uint32_t>(stoul(count));
+    keyHex = fields.substr(keyStart + 1);
+    return job.iterations > 0 && hexDecode(fields.substr(saltStart + 1, keyStart - saltStart - 1), job.salt);
+}
+
+// A stored hash as formatCredential writes it: a full salt and key, and no
+// more iterations than maxIterations, so a login on it costs a bounded time
+bool validCredential(string_view stored, uint32_t maxIterations) {
+    HashJob job;
+    string_view keyHex;
+    string key;
+    return parseCredential(stored, job, keyHex) && job.iterations <= maxIterations
+        && job.salt.size() == PASSWORD_SALT_BYTES && keyHex.size() == 2 * sizeof(job.key) && hexDecode(keyHex, key);
+}
+
+// Hashing threads, one per core by default, that each take up to the
+// kernel's lane count of the jobs waiting at that moment and run them as one
+// batch. A lone login runs alone; under load the lanes fill up.
+class PasswordHasher {
+private:
+    struct Pending {
+        HashJob* job;
+        promise<void> finished;
+    };
+
+    vector<thread> workers;
+    deque<Pending*> queue;
+    mutex queueLock;
+    condition_variable workReady;
+    bool stopping = false;
+    uint32_t iterations;
+
+    void workerLoop() {
+        vector<Pending*> batch;
+        vector<HashJob*> jobs;
+        while (true) {
+            {
+                unique_lock<mutex> lock(queueLock);
+                workReady.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;
+                size_t take = min(queue.size(), activeHashKernel().lanes);
+                batch.assign(queue.begin(), queue.begin() + take);
+                queue.erase(queue.begin(), queue.begin() + take);
+            }
+            jobs.clear();
+            for (Pending* pending : batch) jobs.push_back(pending->job);
+            try {
+                pbkdf2Batch(jobs.data(), jobs.size());
+                for (Pending* pending : batch) pending->finished.set_value();
+            }
+            catch (...) {
+                for (Pending* pending : batch) pending->finished.set_exception(current_exception());
+            }
+        }
+    }
+
+public:
+    explicit PasswordHasher(uint32_t iterations = DEFAULT_HASH_ITERATIONS,
+        unsigned threadCount = max(1u, thread::hardware_concurrency()))
+        : iterations(max(1u, iterations)) {
+        for (unsigned i = 0; i < threadCount; i++) workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~PasswordHasher() {
+        {
+            lock_guard<mutex> lock(queueLock);
+            stopping = true;
+        }
+        workReady.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    PasswordHasher(const PasswordHasher&) = delete;
+    PasswordHasher& operator=(const PasswordHasher&) = delete;
+
+    // Run jobs on the hashing threads and wait for all of them
+    void run(HashJob* jobs, size_t count) {
+        vector<Pending> pending(count);
+        vector<future<void>> finished;
+        finished.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            pending[i].job = &jobs[i];
+            finished.push_back(pending[i].finished.get_future());
+        }
+        {
+            lock_guard<mutex> lock(queueLock);
+            for (auto& p : pending) queue.push_back(&p);
+        }
+        workReady.notify_all();
+        for (auto& f : finished) f.get();
+    }
+
+    uint32_t iterationCount() const {
+        return iterations;
+    }
+
+    // A new salted hash of password in the stored format
+    string hash(const string& password) {
+        HashJob job;
+        job.password = password;
+        job.salt = randomBytes(PASSWORD_SALT_BYTES);
+        job.iterations = iterations;
+        run(&job, 1);
+        return formatCredential(job);
+    }
+
+    // True when password matches a stored credential, hashed or legacy plaintext
+    bool verify(const string& stored, const string& password) {
+        if (!isPasswordHash(stored)) return constantTimeEquals(stored, password);
+        HashJob job;
+        string_view keyHex;
+        if (!parseCredential(stored, job, keyHex)) return false;
+        job.password = password;
+        run(&job, 1);
+        return constantTimeEquals(hexEncode(job.key, sizeof(job.key)), keyHex);
+    }
+};
+
+// ---------- In-memory lookup layer ----------
+
+// Bloom filter over username hashes: a "no" is certain, a "yes" may be wrong
+// about 1% of the time at 10 bits and 7 probes per name. The probes come from
+// the 64-bit hash the store already keeps, so rebuilding it reads no records.
+class BloomFilter {
+private:
+    static const int PROBES = 7;
+    static const size_t BITS_PER_NAME = 10;
+
+    vector<uint64_t> words;
+    size_t bitCount = 0;
+    size_t capacity = 0;  // Names it was sized for
+    size_t count = 0;
+
+    static uint64_t secondHash(uint64_t hash) {
+        hash ^= hash >> 31;
+        hash *= 0x9e3779b97f4a7c15ull;
+        return (hash ^ (hash >> 29)) | 1;
+    }
+
+public:
+    void reset(size_t expectedNames) {
+        capacity = max<size_t>(expectedNames, 1024);
+        bitCount = capacity * BITS_PER_NAME;
+        words.assign((bitCount + 63) / 64, 0);
+        count = 0;
+    }
+
+    void add(uint64_t hash) {
+        uint64_t step = secondHash(hash);
+        for (int i = 0; i < PROBES; i++, hash += step) {
+            size_t bit = hash % bitCount;
+            words[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+        count++;
+    }
+
+    bool mayContain(uint64_t hash) const {
+        uint64_t step = secondHash(hash);
+        for (int i = 0; i < PROBES; i++, hash += step) {
+            size_t bit = hash % bitCount;
+            if (!(words[bit / 64] & (uint64_t(1) << (bit % 64)))) return false;
+        }
+        return true;
+    }
+
+    // More names than it was sized for, so the false-positive rate is climbing
+    bool full() const {
+        return count > capacity;
+    }
+
+    size_t sizeInBytes() const {
+        return words.size() * sizeof(uint64_t);
+    }
+};
+
+// Least-recently-used map of username to stored password hash, bounded to
+// capacity entries
+class LruCache {
+private:
+    list<pair<string, string>> entries;  // Most recent first
+    unordered_map<string, list<pair<string, string>>::iterator> byName;
+    size_t capacity;
+
+public:
+    explicit LruCache(size_t capacity) : capacity(max<size_t>(1, capacity)) {}
+
+    bool get(const string& username, string& password) {
+        auto it = byName.find(username);
+        if (it == byName.end()) return false;
+        entries.splice(entries.begin(), entries, it->second);
+        password = it->second->second;
+        return true;
+    }
+
+    void put(const string& username, const string& password) {
+        auto it = byName.find(username);
+        if (it != byName.end()) {
+            it->second->second = password;
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+        entries.emplace_front(username, password);
+        byName[username] = entries.begin();
+        if (entries.size() > capacity) {
+            byName.erase(entries.back().first);
+            entries.pop_back();
         }
     }
+
+    size_t size() const {
+        return entries.size();
+    }
+};
+
+// Where lookups were answered
+struct LookupStats {
+    atomic<uint64_t> cacheHits{ 0 };
+    atomic<uint64_t> cacheMisses{ 0 };
+    atomic<uint64_t> bloomRejects{ 0 };         // Unknown names turned away without I/O
+    atomic<uint64_t> bloomFalsePositives{ 0 };  // Names the filter passed that the store did not have
+    atomic<uint64_t> storeReads{ 0 };
+};
+
+// Outcome of a UserManager request
+enum class AuthStatus {
+    Ok,
+    UnknownUser,
+    WrongPassword,
+    UserExists,
+    InvalidInput,  // Empty username, or a tab or line break in a field
+    StorageError,
+    BadRequest,    // Service mode: unrecognised or malformed request line
+};
+
+// Short code for service responses
+const char* authStatusName(AuthStatus status) {
+    switch (status) {
+    case AuthStatus::Ok: return "OK";
+    case AuthStatus::UnknownUser: return "UNKNOWN_USER";
+    case AuthStatus::WrongPassword: return "WRONG_PASSWORD";
+    case AuthStatus::UserExists: return "USER_EXISTS";
+    case AuthStatus::InvalidInput: return "INVALID_INPUT";
+    case AuthStatus::StorageError: return "STORAGE_ERROR";
+    case AuthStatus::BadRequest: return "BAD_REQUEST";
+    }
+    return "UNKNOWN";
+}
+
+// ---------- Bulk import/export ----------
+
+// Fixed-capacity queue between pipeline stages: push() blocks while it is
+// full, pop() while it is empty. After close(), push() fails and pop() hands
+// out what is left, then fails.
+template <typename T>
+class BoundedQueue {
+private:
+    deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    mutex lock;
+    condition_variable notFull, notEmpty;
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(max<size_t>(1, capacity)) {}
+
+    bool push(T item) {
+        unique_lock<mutex> guard(lock);
+        notFull.wait(guard, [this] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        unique_lock<mutex> guard(lock);
+        notEmpty.wait(guard, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            lock_guard<mutex> guard(lock);
+            closed = true;
+        }
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+};
+
+// Open-addressing set of username hashes, 8 bytes per name, for spotting
+// names repeated within an import. Distinct names can share a hash, so a
+// hit only means "check again".
+class NameHashSet {
+private:
+    vector<uint64_t> slots = vector<uint64_t>(1024);  // 0 marks an empty slot
+    size_t count = 0;
+
+    static bool placeIn(vector<uint64_t>& table, uint64_t hash) {
+        size_t mask = table.size() - 1;
+        size_t i = hash & mask;
+        while (table[i] != 0) {
+            if (table[i] == hash) return false;
+            i = (i + 1) & mask;
+        }
+        table[i] = hash;
+        return true;
+    }
+
+public:
+    // False if hash was already in the set
+    bool insert(uint64_t hash) {
+        if (hash == 0) hash = 1;
+        if (!placeIn(slots, hash)) return false;
+        if (++count * 4 > slots.size() * 3) {
+            vector<uint64_t> grown(slots.size() * 2);
+            for (uint64_t stored : slots) {
+                if (stored != 0) placeIn(grown, stored);
+            }
+            slots.swap(grown);
+        }
+        return true;
+    }
+};
+
+// Totals of an import, also read by the progress reporter while it runs
+struct ImportCounters {
+    atomic<uint64_t> lines{ 0 };
+    atomic<uint64_t> imported{ 0 };
+    atomic<uint64_t> duplicates{ 0 };  // Already stored, or repeated in the input
+    atomic<uint64_t> invalid{ 0 };     // No comma, empty or unusable username, tab in the password
+    atomic<uint64_t> bytesRead{ 0 };
+};
+
+// Thread-safe: storeLock guards the store and the Bloom filter (shared for
+// lookups, exclusive for registration) and cacheLock the LRU cache, which
+// reorders itself even on reads
+class UserManager {
+private:
+    static const size_t CACHE_CAPACITY = 10000;
+
+    UserStore store;
+    BloomFilter knownNames;
+    LruCache recentUsers{ CACHE_CAPACITY };
+    LookupStats stats;
+    mutable shared_mutex storeLock;
+    mutable mutex cacheLock;
+    PasswordHasher hasher;  // Runs outside both locks
+
+    // One slice of an import on its way through the pipeline
+    struct ImportBatch {
+        uint64_t sequence = 0;        // Input order, restored before writing
+        vector<string> usernames;
+        vector<string> credentials;   // Plaintext until the hashing stage, then the stored form
+        vector<uint8_t> recheck;      // Name hash seen earlier in the input: likely a repeat, not hashed
+    };
+
+    string toLower(const string& str) {
+        string lowered = str;
+        transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+        return lowered;
+    }
+
+    // Move users/<name>.txt files from older versions into the store,
+    // hashing their passwords in one batch, then set the folder aside so
+    // later starts skip it
+    void importLegacyFiles() {
+        if (!filesystem::is_directory("users")) return;
+        vector<string> usernames;
+        vector<HashJob> jobs;
+        for (const auto& entry : filesystem::directory_iterator("users")) {
+            if (entry.path().extension() != ".txt") continue;
+            ifstream file(entry.path());
+            string username, password;
+            if (!getline(file, username) || !getline(file, password)) continue;
+            usernames.push_back(toLower(username));
+            jobs.emplace_back();
+            jobs.back().password = password;
+            jobs.back().salt = randomBytes(PASSWORD_SALT_BYTES);
+            jobs.back().iterations = hasher.iterationCount();
+        }
+        hasher.run(jobs.data(), jobs.size());
+        size_t imported = 0;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (addUser(usernames[i], formatCredential(jobs[i]))) imported++;
+        }
+        // An older build may have made users/ again after an earlier import
+        string target = "users.imported";
+        for (int n = 1; filesystem::exists(target); n++) target = "users.imported." + to_string(n);
+        error_code error;
+        filesystem::rename("users", target, error);
+        if (error) {
+            cerr << YELLOW << "Imported " << imported << " users from users/, but could not rename it to " << target
+                << " (" << error.message() << "); it is read again on the next start.\n" << RESET;
+            return;
+        }
+        cerr << CYAN << "Imported " << imported << " users from users/ (now " << target << "/).\n" << RESET;
+    }
+
+    // Caller holds storeLock exclusively
+    void rebuildFilter() {
+        knownNames.reset(store.size() * 2);
+        store.forEachHash([this](uint64_t hash) { knownNames.add(hash); });
+    }
+
+    // Stored password (hash) of username: the LRU cache first, then the
+    // Bloom filter, and only then the store on disk
+    bool lookupUser(const string& username, string& password) {
+        {
+            lock_guard<mutex> lock(cacheLock);
+            if (recentUsers.get(username, password)) {
+                stats.cacheHits++;
+                return true;
+            }
+        }
+        stats.cacheMisses++;
+        shared_lock<shared_mutex> lock(storeLock);
+        if (!knownNames.mayContain(UserStore::hashName(username))) {
+            stats.bloomRejects++;
+            return false;
+        }
+        stats.storeReads++;
+        if (!store.find(username, password)) {
+            stats.bloomFalsePositives++;
+            return false;
+        }
+        return true;
+    }
+
+    // Store a new user; false if the name was taken first
+    bool addUser(const string& username, const string& credential) {
+        {
+            unique_lock<shared_mutex> lock(storeLock);
+            if (store.contains(username)) return false;
+            store.put(username, credential);
+            knownNames.add(UserStore::hashName(username));
+            if (knownNames.full()) rebuildFilter();
+        }
+        lock_guard<mutex> lock(cacheLock);
+        recentUsers.put(username, credential);
+        return true;
+    }
+
+    // Swap a verified legacy plaintext password for its hash, unless the
+    // record changed meanwhile
+    void upgradeCredential(const string& username, const string& oldCredential, const string& password) {
+        string upgraded = hasher.hash(password), current;
+        {
+            unique_lock<shared_mutex> lock(storeLock);
+            if (!store.find(username, current) || current != oldCredential) return;
+            store.put(username, upgraded);
+        }
+        lock_guard<mutex> lock(cacheLock);
+        recentUsers.put(username, upgraded);
+    }
+
+    static bool validField(const string& value) {
+        return value.find_first_of("\t\n\r") == string::npos;
+    }
+
+    // Reader stage: drop names the store already has, under one shared lock
+    // for the whole batch, and flag names whose hash came up before
+    void screenBatch(ImportBatch& batch, NameHashSet& seen, ImportCounters& counters) {
+        size_t kept = 0;
+        shared_lock<shared_mutex> lock(storeLock);
+        for (size_t i = 0; i < batch.usernames.size(); i++) {
+            if (store.contains(batch.usernames[i])) {
+                counters.duplicates++;
+                continue;
+            }
+            if (kept != i) {
+                batch.usernames[kept] = move(batch.usernames[i]);
+                batch.credentials[kept] = move(batch.credentials[i]);
+            }
+            batch.recheck.push_back(!seen.insert(UserStore::hashName(batch.usernames[kept])));
+            kept++;
+        }
+        batch.usernames.resize(kept);
+        batch.credentials.resize(kept);
+    }
+
+    // Hash the plaintext passwords at the given positions of a batch in one run
+    void hashCredentials(ImportBatch& batch, const vector<size_t>& positions) {
+        vector<HashJob> jobs(positions.size());
+        for (size_t k = 0; k < jobs.size(); k++) {
+            jobs[k].password = move(batch.credentials[positions[k]]);
+            jobs[k].salt = randomBytes(PASSWORD_SALT_BYTES);
+            jobs[k].iterations = hasher.iterationCount();
+        }
+        hasher.run(jobs.data(), jobs.size());
+        for (size_t k = 0; k < jobs.size(); k++) batch.credentials[positions[k]] = formatCredential(jobs[k]);
+    }
+
+    // Hashing stage: every plaintext password of the batch in one run
+    void hashBatch(ImportBatch& batch) {
+        vector<size_t> positions;
+        for (size_t i = 0; i < batch.credentials.size(); i++) {
+            if (!batch.recheck[i] && !isPasswordHash(batch.credentials[i])) positions.push_back(i);
+        }
+        hashCredentials(batch, positions);
+    }
+
+    // Writer stage: settle flagged names exactly, then append the batch with
+    // one write
+    void writeBatch(ImportBatch& batch, ImportCounters& counters) {
+        bool flagged = find(batch.recheck.begin(), batch.recheck.end(), 1) != batch.recheck.end();
+        unordered_set<string> batchNames;  // Only needed to settle flagged names
+        vector<string> usernames, credentials;
+        if (flagged) {
+            // A flagged name that is neither stored nor repeated in the batch
+            // merely shared a hash; rare, but hash it before taking the
+            // exclusive lock so logins are not held up behind it. Only this
+            // stage adds imported names, so the answer can only turn into
+            // a duplicate meanwhile, which the loop below catches.
+            vector<size_t> positions;
+            {
+                shared_lock<shared_mutex> lock(storeLock);
+                for (size_t i = 0; i < batch.usernames.size(); i++) {
+                    bool repeated = !batchNames.insert(batch.usernames[i]).second;
+                    if (!batch.recheck[i] || repeated || isPasswordHash(batch.credentials[i])) continue;
+                    if (!store.contains(batch.usernames[i])) positions.push_back(i);
+                }
+            }
+            hashCredentials(batch, positions);
+            batchNames.clear();
+        }
+        unique_lock<shared_mutex> lock(storeLock);
+        for (size_t i = 0; i < batch.usernames.size(); i++) {
+            string& username = batch.usernames[i];
+            string& credential = batch.credentials[i];
+            // Unflagged names can only clash with a registration made since screening
+            if (store.contains(username) || (batch.recheck[i] && batchNames.count(username))) {
+                counters.duplicates++;
+                continue;
+            }
+            if (flagged) batchNames.insert(username);
+            usernames.push_back(move(username));
+            credentials.push_back(move(credential));
+        }
+        store.putBatch(usernames, credentials);
+        for (const string& username : usernames) knownNames.add(UserStore::hashName(username));
+        if (knownNames.full()) rebuildFilter();
+        counters.imported += usernames.size();
+    }
+
+public:
+    explicit UserManager(uint32_t hashIterations = DEFAULT_HASH_ITERATIONS) : hasher(hashIterations) {
+        {
+            unique_lock<shared_mutex> lock(storeLock);
+            rebuildFilter();
+        }
+        importLegacyFiles();
+    }
+
+    bool userExists(const string& name) {
+        string password;
+        return lookupUser(toLower(name), password);
+    }
+
+    AuthStatus registerAccount(const string& name, const string& password) {
+        string username = toLower(name);
+        if (username.empty() || !validField(username) || !validField(password)) return AuthStatus::InvalidInput;
+        try {
+            if (userExists(username)) return AuthStatus::UserExists;
+            return addUser(username, hasher.hash(password)) ? AuthStatus::Ok : AuthStatus::UserExists;
+        }
+        catch (const exception&) {
+            return AuthStatus::StorageError;
+        }
+    }
+
+    AuthStatus login(const string& name, const string& password) {
+        string username = toLower(name), storedPass;
+        try {
+            if (!lookupUser(username, storedPass)) return AuthStatus::UnknownUser;
+            if (!hasher.verify(storedPass, password)) return AuthStatus::WrongPassword;
+            if (!isPasswordHash(storedPass)) {
+                upgradeCredential(username, storedPass, password);
+                return AuthStatus::Ok;
+            }
+        }
+        catch (const exception&) {
+            return AuthStatus::StorageError;
+        }
+        lock_guard<mutex> lock(cacheLock);
+        recentUsers.put(username, storedPass);
+        return AuthStatus::Ok;
+    }
+
+    // Counters as one line of name=value pairs
+    string statsLine() const {
+        size_t users, cached;
+        {
+            shared_lock<shared_mutex> lock(storeLock);
+            users = store.size();
+        }
+        {
+            lock_guard<mutex> lock(cacheLock);
+            cached = recentUsers.size();
+        }
+        return "users=" + to_string(users) + " cache_hits=" + to_string(stats.cacheHits)
+            + " cache_misses=" + to_string(stats.cacheMisses) + " cache_entries=" + to_string(cached)
+            + " bloom_rejects=" + to_string(stats.bloomRejects)
+            + " bloom_false_positives=" + to_string(stats.bloomFalsePositives)
+            + " store_reads=" + to_string(stats.storeReads);
+    }
+
+    void printStats() const {
+        shared_lock<shared_mutex> lock(storeLock);
+        uint64_t lookups = stats.cacheHits + stats.cacheMisses;
+        cout << CYAN << "\n[Lookup Statistics]\n" << RESET;
+        cout << "Users stored:          " << store.size() << "\n";
+        cout << "Lookups:               " << lookups << "\n";
+        cout << "Cache hits / misses:   " << stats.cacheHits << " / " << stats.cacheMisses
+            << " (" << recentUsers.size() << " of " << CACHE_CAPACITY << " entries in use)\n";
+        cout << "Bloom filter rejects:  " << stats.bloomRejects << " (" << knownNames.sizeInBytes() / 1024 << " KiB)\n";
+        cout << "False positives:       " << stats.bloomFalsePositives << "\n";
+        cout << "Store reads:           " << stats.storeReads << "\n";
+    }
+
+    // Stream "username,password" lines into the store through three stages:
+    // a reader thread parses, lowercases and screens out names already
+    // stored, hashing threads hash each batch's passwords, and this thread
+    // writes the batches back in input order. The first line for a name
+    // wins; values already in the stored hash format (an export) are kept
+    // as they are if they are well formed, and counted invalid otherwise.
+    // An optional "username,password" header line is skipped.
+    void importUsers(istream& in, ImportCounters& counters) {
+        static const size_t BATCH_SIZE = 4096;
+        unsigned hashStages = max(2u, thread::hardware_concurrency());
+        uint32_t maxIterations = max(MAX_IMPORT_HASH_ITERATIONS, hasher.iterationCount());
+        BoundedQueue<unique_ptr<ImportBatch>> parsed(hashStages * 2), hashed(hashStages * 2);
+        atomic<unsigned> hashStagesLeft{ hashStages };
+        exception_ptr failure;
+        mutex failureLock;
+        // Record the first error and unblock every stage so they wind down
+        auto fail = [&] {
+            {
+                lock_guard<mutex> lock(failureLock);
+                if (!failure) failure = current_exception();
+            }
+            parsed.close();
+            hashed.close();
+        };
+
+        thread reader([&] {
+            try {
+                NameHashSet seen;
+                uint64_t sequence = 0;
+                auto batch = make_unique<ImportBatch>();
+                auto send = [&] {
+                    screenBatch(*batch, seen, counters);
+                    if (batch->usernames.empty()) return true;
+                    batch->sequence = sequence++;
+                    if (!parsed.push(move(batch))) return false;
+                    batch = make_unique<ImportBatch>();
+                    return true;
+                };
+                string line;
+                bool firstLine = true;
+                while (getline(in, line)) {
+                    counters.bytesRead += line.size() + 1;
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                    if (firstLine) {
+                        firstLine = false;
+                        if (toLower(line) == "username,password") continue;
+                    }
+                    counters.lines++;
+                    size_t comma = line.find(',');
+                    if (comma == string::npos) {
+                        counters.invalid++;
+                        continue;
+                    }
+                    string username = toLower(line.substr(0, comma));
+                    string password = line.substr(comma + 1);
+                    // Usernames come from whitespace-separated input everywhere else
+                    if (username.empty() || username.find_first_of(" \t\n\r") != string::npos || !validField(password)
+                        || (isPasswordHash(password) && !validCredential(password, maxIterations))) {
+                        counters.invalid++;
+                        continue;
+                    }
+                    batch->usernames.push_back(move(username));
+                    batch->credentials.push_back(move(password));
+                    if (batch->usernames.size() == BATCH_SIZE && !send()) return;
+                }
+                if (in.bad()) throw runtime_error("Unable to read the import input.");
+                if (!batch->usernames.empty()) send();
+                parsed.close();
+            }
+            catch (...) {
+                fail();
+            }
+        });
+
+        vector<thread> hashers;
+        for (unsigned i = 0; i < hashStages; i++) {
+            hashers.emplace_back([&] {
+                try {
+                    unique_ptr<ImportBatch> batch;
+                    while (parsed.pop(batch)) {
+                        hashBatch(*batch);
+                        if (!hashed.push(move(batch))) break;
+                    }
+                }
+                catch (...) {
+                    fail();
+                }
+                if (--hashStagesLeft == 0) hashed.close();
+            });
+        }
+
+        try {
+            map<uint64_t, unique_ptr<ImportBatch>> waiting;  // Finished out of order
+            uint64_t next = 0;
+            unique_ptr<ImportBatch> batch;
+            while (hashed.pop(batch)) {
+                uint64_t sequence = batch->sequence;
+                waiting[sequence] = move(batch);
+                for (auto it = waiting.find(next); it != waiting.end(); it = waiting.find(++next)) {
+                    writeBatch(*it->second, counters);
+                    waiting.erase(it);
+                }
+            }
+        }
+        catch (...) {
+            fail();
+        }
+        reader.join();
+        for (auto& stage : hashers) stage.join();
+
+        // Whatever was written is complete, so index it even after a failure
+        {
+            unique_lock<shared_mutex> lock(storeLock);
+            store.flushIndex();
+        }
+        if (failure) rethrow_exception(failure);
+    }
+
+    // Write every user as "username,password" lines under a header line,
+    // passwords in their stored (hashed) form, reading users.dat in one
+    // sequential pass. Names with a comma cannot round-trip and are
+    // skipped. Returns the number of users written.
+    uint64_t exportUsers(ostream& out, uint64_t& skipped) const {
+        static const uint64_t PROGRESS_EVERY = 1000000;
+        uint64_t exported = 0;
+        skipped = 0;
+        string buffer = "username,password\n";
+        shared_lock<shared_mutex> lock(storeLock);
+        store.forEachRecord([&](string_view username, string_view password) {
+            if (username.find(',') != string_view::npos) {
+                skipped++;
+                return;
+            }
+            buffer.append(username);
+            buffer += ',';
+            buffer.append(password);
+            buffer += '\n';
+            if (buffer.size() >= (1 << 20)) {
+                out.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+            if (++exported % PROGRESS_EVERY == 0) {
+                cerr << "  " << exported << " of " << store.size() << " users exported\n";
+            }
+        });
+        out.write(buffer.data(), buffer.size());
+        out.flush();
+        if (!out) throw runtime_error("Unable to write the export output.");
+        return exported;
+    }
+
+    void registerUser() {
+        string username, password, confirmPass;
+        cout << CYAN << "\n[User Registration]\n" << RESET;
+
+        cout << "Enter username: ";
+        cin >> username;
+        username = toLower(username);
+
+        if (userExists(username)) {
+            cout << RED << "Username already exists. Try another.\n" << RESET;
+            return;
+        }
+
+        cin.ignore(); // Clear buffer
+        password = getPasswordInput("Enter password: ");
+        confirmPass = getPasswordInput("Confirm password: ");
+
+        if (password != confirmPass) {
+            cout << RED << "Passwords do not match.\n" << RESET;
+            return;
+        }
+
+        AuthStatus status = registerAccount(username, password);
+        if (status == AuthStatus::Ok) {
+            cout << GREEN << "User registered successfully!\n" << RESET;
+        }
+        else if (status == AuthStatus::UserExists) {
+            cout << RED << "Username already exists. Try another.\n" << RESET;
+        }
+        else if (status == AuthStatus::InvalidInput) {
+            cout << RED << "Registration failed: passwords cannot contain tabs or line breaks.\n" << RESET;
+        }
+        else {
+            cout << RED << "Registration failed: could not write the user store.\n" << RESET;
+        }
+    }
+
+    void loginUser() {
+        string username, password;
+        cout << CYAN << "\n[User Login]\n" << RESET;
+
+        cout << "Enter username: ";
+        cin >> username;
+        username = toLower(username);
+
+        if (!userExists(username)) {
+            cout << RED << "Account does not exist.\n" << RESET;
+            return;
+        }
+
+        cin.ignore(); // Clear buffer
+        password = getPasswordInput("Enter password: ");
+
+        AuthStatus status = login(username, password);
+        if (status == AuthStatus::Ok) {
+            cout << GREEN << "Login successful. Welcome, " << username << "!\n" << RESET;
+        }
+        else if (status == AuthStatus::StorageError) {
+            cout << RED << "Login error: could not read the user store.\n" << RESET;
+        }
+        else {
+            cout << RED << "Invalid credentials.\n" << RESET;
+        }
+    }
+};
+
+// ---------- Service mode ----------
+// Requests are one line each, answered with one line:
+//   REGISTER <username> <password>   -> OK | USER_EXISTS | INVALID_INPUT | STORAGE_ERROR
+//   LOGIN <username> <password>      -> OK | UNKNOWN_USER | WRONG_PASSWORD | STORAGE_ERROR
+//   STATS                            -> OK <name=value ...>
+// The password is the rest of the line after the username, so it may contain
+// spaces. Anything else gets BAD_REQUEST.
+
+// Fixed set of worker threads, each with its own queue. Jobs submitted with
+// the same key run on the same worker in submission order, so requests for
+// one username never overtake each other.
+class WorkerPool {
+private:
+    struct Lane {
+        deque<function<void()>> jobs;
+        mutex lock;
+        condition_variable ready;
+        bool stopping = false;
+    };
+    vector<unique_ptr<Lane>> lanes;
+    vector<thread> workers;
+
+    static void work(Lane& lane) {
+        while (true) {
+            function<void()> job;
+            {
+                unique_lock<mutex> lock(lane.lock);
+                lane.ready.wait(lock, [&lane] { return lane.stopping || !lane.jobs.empty(); });
+                if (lane.jobs.empty()) return;
+                job = move(lane.jobs.front());
+                lane.jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+public:
+    explicit WorkerPool(unsigned threadCount) {
+        threadCount = max(1u, threadCount);
+        for (unsigned i = 0; i < threadCount; i++) lanes.push_back(make_unique<Lane>());
+        for (auto& lane : lanes) workers.emplace_back(work, ref(*lane));
+    }
+
+    // Finishes every queued job before returning
+    ~WorkerPool() {
+        for (auto& lane : lanes) {
+            lock_guard<mutex> lock(lane->lock);
+            lane->stopping = true;
+            lane->ready.notify_one();
+        }
+        for (auto& worker : workers) worker.join();
+    }
+
+    unsigned size() const {
+        return static_cast<unsigned>(workers.size());
+    }
+
+    void submit(uint64_t key, function<void()> job) {
+        Lane& lane = *lanes[key % lanes.size()];
+        {
+            lock_guard<mutex> lock(lane.lock);
+            lane.jobs.push_back(move(job));
+        }
+        lane.ready.notify_one();
+    }
+};
+
+// Split a request into verb, username and password; the password keeps any spaces
+void parseRequest(const string& line, string& verb, string& username, string& password) {
+    size_t verbEnd = line.find(' ');
+    verb = line.substr(0, verbEnd);
+    username.clear();
+    password.clear();
+    if (verbEnd == string::npos) return;
+    size_t nameEnd = line.find(' ', verbEnd + 1);
+    username = line.substr(verbEnd + 1, nameEnd == string::npos ? string::npos : nameEnd - verbEnd - 1);
+    if (nameEnd != string::npos) password = line.substr(nameEnd + 1);
+}
+
+string handleRequest(UserManager& users, const string& line) {
+    string verb, username, password;
+    parseRequest(line, verb, username, password);
+    if (verb == "STATS" && username.empty()) return string("OK ") + users.statsLine();
+    if (username.empty()) return authStatusName(AuthStatus::BadRequest);
+    if (verb == "REGISTER") return authStatusName(users.registerAccount(username, password));
+    if (verb == "LOGIN") return authStatusName(users.login(username, password));
+    return authStatusName(AuthStatus::BadRequest);
+}
+
+// Worker key for a request: its username, so one user's requests stay in order
+uint64_t requestKey(const string& line) {
+    string verb, username, password;
+    parseRequest(line, verb, username, password);
+    transform(username.begin(), username.end(), username.begin(), ::tolower);
+    return UserStore::hashName(username);
+}
+
+// Line protocol on stdin/stdout. Up to four requests per worker are in
+// flight at once; responses are printed in request order. STATS waits for
+// every earlier request, so its counters include them.
+int runStdinService(UserManager& users, unsigned workerCount) {
+    WorkerPool pool(workerCount);
+    const size_t WINDOW = size_t(pool.size()) * 4;
+    deque<future<string>> inFlight;
+    string line, out, verb, username, password;
+    auto emit = [&] {
+        out += inFlight.front().get();
+        out += '\n';
+        inFlight.pop_front();
+        if (out.size() >= (1 << 16)) {
+            cout << out << flush;
+            out.clear();
+        }
+    };
+    while (getline(cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        parseRequest(line, verb, username, password);
+        if (verb == "STATS") {
+            while (!inFlight.empty()) emit();
+            out += handleRequest(users, line);
+            out += '\n';
+            continue;
+        }
+        auto task = make_shared<packaged_task<string()>>([&users, line] { return handleRequest(users, line); });
+        inFlight.push_back(task->get_future());
+        pool.submit(requestKey(line), [task] { (*task)(); });
+        if (inFlight.size() >= WINDOW) emit();
+    }
+    while (!inFlight.empty()) emit();
+    cout << out << flush;
+    return 0;
+}
+
+#ifdef __linux__
+
+volatile sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+// Unix domain socket server: one epoll loop owns every connection and does
+// all socket I/O, while the pool runs the requests. A connection has at most
+// one request in flight; further pipelined lines wait in its queue, so each
+// client sees its responses in order. Finished requests come back through a
+// completion list and an eventfd that wakes the loop.
+class AuthServer {
+private:
+    struct Connection {
+        int fd = -1;
+        string in;
+        string out;
+        deque<string> pending;
+        bool busy = false;
+        bool peerClosed = false;
+        uint32_t events = EPOLLIN | EPOLLRDHUP;  // What epoll is watching for; 0 = not in the epoll set
+    };
+
+    static const uint64_t LISTEN_ID = 0;
+    static const uint64_t WAKE_ID = 1;
+    static const size_t MAX_LINE = 4096;
+
+    UserManager& users;
+    WorkerPool& pool;
+    string socketPath;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    unordered_map<uint64_t, Connection> connections;  // By ID, so a reused fd never gets a stale response
+    uint64_t nextId = 2;
+    size_t inFlight = 0;
+
+    mutex doneLock;
+    vector<pair<uint64_t, string>> done;
+
+    void watch(int fd, uint64_t id, uint32_t events, int op) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = id;
+        if (epoll_ctl(epollFd, op, fd, &event) != 0) throw runtime_error("epoll_ctl failed: " + string(strerror(errno)));
+    }
+
+    void closeConnection(uint64_t id) {
+        auto it = connections.find(id);
+        if (it == connections.end()) return;
+        ::close(it->second.fd);  // Also removes it from the epoll set
+        connections.erase(it);
+    }
+
+    void acceptConnections() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            uint64_t id = nextId++;
+            connections[id].fd = fd;
+            watch(fd, id, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+        }
+    }
+
+    // Hand the connection's next request to the pool if none is running
+    void dispatch(uint64_t id, Connection& connection) {
+        if (connection.busy || connection.pending.empty()) return;
+        string line = move(connection.pending.front());
+        connection.pending.pop_front();
+        connection.busy = true;
+        inFlight++;
+        uint64_t key = requestKey(line);
+        pool.submit(key, [this, id, line] {
+            string response = handleRequest(users, line);
+            {
+                lock_guard<mutex> lock(doneLock);
+                done.emplace_back(id, move(response));
+            }
+            uint64_t one = 1;
+            if (::write(wakeFd, &one, sizeof(one)) < 0) {
+                // The counter is already non-zero; the loop will wake anyway
+            }
+        });
+    }
+
+    // Write what we can; returns false once the connection is closed
+    bool flush(uint64_t id, Connection& connection) {
+        while (!connection.out.empty()) {
+            ssize_t n = ::send(connection.fd, connection.out.data(), connection.out.size(), MSG_NOSIGNAL);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (n <= 0) {
+                closeConnection(id);
+                return false;
+            }
+            connection.out.erase(0, static_cast<size_t>(n));
+        }
+        if (connection.peerClosed && !connection.busy && connection.pending.empty() && connection.out.empty()) {
+            closeConnection(id);
+            return false;
+        }
+        // Reads stop once the peer has closed its end; writes are watched only
+        // while output is queued. With nothing left to watch the fd leaves the
+        // epoll set, since a hung-up socket reports EPOLLHUP even under an
+        // empty mask and would wake the loop until the response is ready.
+        uint32_t events = (connection.peerClosed ? 0 : EPOLLIN | EPOLLRDHUP) | (connection.out.empty() ? 0u : uint32_t(EPOLLOUT));
+        if (events != connection.events) {
+            if (events == 0) {
+                if (epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr) != 0) {
+                    throw runtime_error("epoll_ctl failed: " + string(strerror(errno)));
+                }
+            }
+            else {
+                watch(connection.fd, id, events, connection.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD);
+            }
+            connection.events = events;
+        }
+        return true;
+    }
+
+    void readRequests(uint64_t id, Connection& connection) {
+        char buffer[16384];
+        while (!connection.peerClosed) {
+            ssize_t n = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                connection.in.append(buffer, static_cast<size_t>(n));
+                continue;
+            }
+            if (n == 0) connection.peerClosed = true;
+            else if (errno != EAGAIN && errno != EWOULDBLOCK) connection.peerClosed = true;
+            break;
+        }
+        size_t start = 0, newline;
+        while ((newline = connection.in.find('\n', start)) != string::npos) {
+            string line = connection.in.substr(start, newline - start);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) connection.pending.push_back(move(line));
+            start = newline + 1;
+        }
+        connection.in.erase(0, start);
+        if (connection.in.size() > MAX_LINE) {
+            closeConnection(id);
+            return;
+        }
+        dispatch(id, connection);
+        flush(id, connection);
+    }
+
+    void collectResponses() {
+        uint64_t count;
+        if (::read(wakeFd, &count, sizeof(count)) < 0) {
+            // Nothing pending; another wakeup already drained it
+        }
+        vector<pair<uint64_t, string>> finished;
+        {
+            lock_guard<mutex> lock(doneLock);
+            finished.swap(done);
+        }
+        for (auto& [id, response] : finished) {
+            inFlight--;
+            auto it = connections.find(id);
+            if (it == connections.end()) continue;
+            Connection& connection = it->second;
+            connection.busy = false;
+            connection.out += response;
+            connection.out += '\n';
+            dispatch(id, connection);
+            flush(id, connection);
+        }
+    }
+
+public:
+    AuthServer(UserManager& users, WorkerPool& pool, const string& socketPath)
+        : users(users), pool(pool), socketPath(socketPath) {
+        sockaddr_un address{};
+        if (socketPath.size() >= sizeof(address.sun_path)) throw runtime_error("Socket path is too long.");
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+        struct stat info;
+        if (::stat(socketPath.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) ::unlink(socketPath.c_str());
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || ::listen(listenFd, SOMAXCONN) != 0) {
+            throw runtime_error("Unable to listen on " + socketPath + ": " + strerror(errno));
+        }
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0) throw runtime_error("Unable to set up epoll: " + string(strerror(errno)));
+        watch(listenFd, LISTEN_ID, EPOLLIN, EPOLL_CTL_ADD);
+        watch(wakeFd, WAKE_ID, EPOLLIN, EPOLL_CTL_ADD);
+    }
+
+    ~AuthServer() {
+        for (auto& entry : connections) ::close(entry.second.fd);
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            ::unlink(socketPath.c_str());
+        }
+        if (wakeFd >= 0) ::close(wakeFd);
+        if (epollFd >= 0) ::close(epollFd);
+    }
+
+    AuthServer(const AuthServer&) = delete;
+    AuthServer& operator=(const AuthServer&) = delete;
+
+    // Serve until SIGINT or SIGTERM, then wait for requests already running
+    void run() {
+        epoll_event events[128];
+        while (!stopRequested || inFlight > 0) {
+            int timeout = stopRequested ? 100 : -1;
+            int n = epoll_wait(epollFd, events, 128, timeout);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw runtime_error("epoll_wait failed: " + string(strerror(errno)));
+            }
+            for (int i = 0; i < n; i++) {
+                uint64_t id = events[i].data.u64;
+                if (id == LISTEN_ID) {
+                    if (!stopRequested) acceptConnections();
+                    continue;
+                }
+                if (id == WAKE_ID) {
+                    collectResponses();
+                    continue;
+                }
+                auto it = connections.find(id);
+                if (it == connections.end()) continue;
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    readRequests(id, it->second);
+                }
+                else if (events[i].events & EPOLLOUT) {
+                    flush(id, it->second);
+                }
+            }
+        }
+    }
+};
+
+int runSocketService(UserManager& users, const string& socketPath, unsigned workerCount) {
+    struct sigaction action{};
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    WorkerPool pool(workerCount);
+    AuthServer server(users, pool, socketPath);
+    cerr << CYAN << "Serving on " << socketPath << " with " << pool.size() << " workers (Ctrl+C to stop)\n" << RESET;
+    server.run();
+    cerr << CYAN << "Stopped. " << users.statsLine() << "\n" << RESET;
+    return 0;
+}
+
+// ---------- Load generator ----------
+// Registers loadN users through a running server, then sends login requests
+// from several connections at once, one request in flight per connection:
+// eight in ten with the right password, one with a wrong password and one
+// for a name that does not exist. Reports ops/sec and latency percentiles
+// and fails if any response was not the expected one.
+
+struct LoadOptions {
+    string socketPath;
+    unsigned connections = 16;
+    size_t requests = 100000;
+    size_t users = 1000;
+};
+
+// Blocking client connection that sends one request and waits for its line
+class AuthClient {
+private:
+    int fd = -1;
+    string buffer;
+
+public:
+    explicit AuthClient(const string& socketPath) {
+        sockaddr_un address{};
+        if (socketPath.size() >= sizeof(address.sun_path)) throw runtime_error("Socket path is too long.");
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+        fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            if (fd >= 0) ::close(fd);
+            throw runtime_error("Unable to connect to " + socketPath + ": " + strerror(errno));
+        }
+    }
+
+    ~AuthClient() {
+        ::close(fd);
+    }
+
+    AuthClient(const AuthClient&) = delete;
+    AuthClient& operator=(const AuthClient&) = delete;
+
+    string request(const string& line) {
+        string message = line + '\n';
+        if (!sendAll(fd, message)) throw runtime_error("Connection lost while sending.");
+        size_t newline;
+        char chunk[4096];
+        while ((newline = buffer.find('\n')) == string::npos) {
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) throw runtime_error("Connection lost while waiting for a response.");
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+        string response = buffer.substr(0, newline);
+        buffer.erase(0, newline + 1);
+        return response;
+    }
+
+private:
+    static bool sendAll(int fd, const string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+};
+
+double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size());
+    return sorted[min(rank, sorted.size() - 1)];
+}
+
+int runLoadGenerator(const LoadOptions& options) {
+    try {
+        size_t userCount = max<size_t>(1, options.users);
+        {
+            AuthClient setup(options.socketPath);
+            for (size_t i = 0; i < userCount; i++) {
+                string response = setup.request("REGISTER load" + to_string(i) + " secret" + to_string(i));
+                if (response != "OK" && response != "USER_EXISTS") throw runtime_error("Registration failed: " + response);
+            }
+        }
+
+        vector<vector<double>> latencies(options.connections);
+        atomic<size_t> nextRequest{ 0 }, unexpected{ 0 }, failedClients{ 0 };
+        auto client = [&](unsigned index) {
+            try {
+                AuthClient connection(options.socketPath);
+                auto& samples = latencies[index];
+                for (size_t i; (i = nextRequest.fetch_add(1, memory_order_relaxed)) < options.requests;) {
+                    size_t user = (i * 2654435761u) % userCount;
+                    string line, expected;
+                    switch (i % 10) {
+                    case 8:
+                        line = "LOGIN load" + to_string(user) + " wrong";
+                        expected = "WRONG_PASSWORD";
+                        break;
+                    case 9:
+                        line = "LOGIN ghost" + to_string(i) + " secret";
+                        expected = "UNKNOWN_USER";
+                        break;
+                    default:
+                        line = "LOGIN load" + to_string(user) + " secret" + to_string(user);
+                        expected = "OK";
+                    }
+                    auto begin = chrono::steady_clock::now();
+                    string response = connection.request(line);
+                    samples.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count());
+                    if (response != expected) unexpected++;
+                }
+            }
+            catch (const exception& e) {
+                cerr << RED << "Client " << index << ": " << e.what() << RESET << endl;
+                failedClients++;
+            }
+        };
+
+        auto start = chrono::steady_clock::now();
+        vector<thread> clients;
+        for (unsigned c = 0; c < options.connections; c++) clients.emplace_back(client, c);
+        for (auto& c : clients) c.join();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        vector<double> all;
+        for (auto& samples : latencies) all.insert(all.end(), samples.begin(), samples.end());
+        sort(all.begin(), all.end());
+        cout << "Requests: " << all.size() << " over " << options.connections << " connections in "
+            << fixed << setprecision(2) << seconds << " s (" << setprecision(0) << all.size() / max(seconds, 1e-9)
+            << " auth ops/sec)\n";
+        cout << setprecision(1) << "Latency (us): p50 " << percentile(all, 50) << ", p99 " << percentile(all, 99)
+            << ", p999 " << percentile(all, 99.9) << ", max " << (all.empty() ? 0 : all.back()) << "\n";
+        cout << "Server: " << AuthClient(options.socketPath).request("STATS") << "\n";
+        if (unexpected > 0 || failedClients > 0) {
+            cout << RED << "FAIL: " << unexpected << " unexpected responses, " << failedClients << " failed connections\n" << RESET;
+            return 1;
+        }
+    }
+    catch (const exception& e) {
+        cerr << RED << "Error: " << e.what() << RESET << endl;
+        return 1;
+    }
+    return 0;
+}
+
+#endif
+
+void clearInput() {
+    cin.clear();
+    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+}
+
+void displayMenu() {
+    cout << YELLOW << "\n========= Welcome to Secure Login System =========\n" << RESET;
+    cout << "1. Register a New User\n";
+    cout << "2. Login\n";
+    cout << "3. Lookup Statistics\n";
+    cout << "4. Exit\n";
+    cout << CYAN << "Choose an option: " << RESET;
+}
+
+// ---------- Hash benchmark ----------
+// Checks every kernel against the RFC 7914 PBKDF2-HMAC-SHA256 vectors and
+// against each other, times each one on a single thread (hashes/sec per
+// core), then times the active kernel through the hasher on every core.
+
+struct HashBenchOptions {
+    size_t hashes = 256;
+    uint32_t iterations = DEFAULT_HASH_ITERATIONS;
+};
+
+int runHashBenchmark(const HashBenchOptions& options) {
+    struct KnownAnswer {
+        uint32_t iterations;
+        const char* key;
+    };
+    const KnownAnswer VECTORS[] = {
+        { 1, "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b" },
+        { 2, "ae4d0c95af6b46d32d0adff928f06dd02a303f8ef3c251dfd6e2d85a95474c43" },
+        { 4096, "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a" },
+    };
+
+    vector<HashKernel> kernels = { { "scalar", roundsScalar, 1 } };
+#ifdef LOGIN_X86
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({ "avx2", roundsAvx2, 8 });
+#endif
+
+    bool passed = true;
+    vector<HashJob> reference(max<size_t>(1, options.hashes));
+    for (size_t i = 0; i < reference.size(); i++) {
+        reference[i].password = "bench-password-" + to_string(i);
+        reference[i].salt = randomBytes(PASSWORD_SALT_BYTES);
+        reference[i].iterations = options.iterations;
+    }
+
+    double scalarRate = 0;
+    vector<uint8_t> scalarKeys;
+    for (const HashKernel& kernel : kernels) {
+        for (const KnownAnswer& known : VECTORS) {
+            HashJob job;
+            job.password = "password";
+            job.salt = "salt";
+            job.iterations = known.iterations;
+            HashJob* jobs[] = { &job };
+            pbkdf2Batch(jobs, 1, kernel);
+            if (hexEncode(job.key, sizeof(job.key)) != known.key) {
+                cout << RED << "FAIL: " << kernel.name << " kernel gives the wrong key at " << known.iterations << " iterations\n" << RESET;
+                passed = false;
+            }
+        }
+
+        vector<HashJob> jobs = reference;
+        vector<HashJob*> pointers;
+        for (auto& job : jobs) pointers.push_back(&job);
+        auto start = chrono::steady_clock::now();
+        pbkdf2Batch(pointers.data(), pointers.size(), kernel);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double rate = jobs.size() / max(seconds, 1e-9);
+
+        vector<uint8_t> keys;
+        for (const auto& job : jobs) keys.insert(keys.end(), job.key, job.key + sizeof(job.key));
+        if (scalarKeys.empty()) {
+            scalarKeys = keys;
+            scalarRate = rate;
+        }
+        else if (keys != scalarKeys) {
+            cout << RED << "FAIL: " << kernel.name << " kernel disagrees with the scalar kernel\n" << RESET;
+            passed = false;
+        }
+        cout << left << setw(8) << kernel.name << right << " " << kernel.lanes << " lane" << (kernel.lanes == 1 ? " " : "s")
+            << fixed << setprecision(0) << setw(10) << rate << " hashes/sec per core"
+            << setprecision(2) << "  (" << rate / max(scalarRate, 1e-9) << "x scalar)\n";
+    }
+
+    {
+        PasswordHasher hasher(options.iterations);
+        vector<HashJob> jobs = reference;
+        jobs.resize(max<size_t>(jobs.size(), size_t(thread::hardware_concurrency()) * activeHashKernel().lanes * 4), reference[0]);
+        auto start = chrono::steady_clock::now();
+        hasher.run(jobs.data(), jobs.size());
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Hasher (" << activeHashKernel().name << ", " << max(1u, thread::hardware_concurrency()) << " threads): "
+            << setprecision(0) << jobs.size() / max(seconds, 1e-9) << " hashes/sec at " << options.iterations << " iterations\n";
+    }
+
+    if (passed) cout << GREEN << "PASS: every kernel matches the test vectors and the scalar kernel\n" << RESET;
+    return passed ? 0 : 1;
+}
+
+// Import a CSV file (or stdin for "-") and report progress on stderr once a second
+int runImport(UserManager& users, const string& path) {
+    ifstream file;
+    vector<char> buffer(1 << 20);
+    uint64_t inputBytes = 0;
+    if (path != "-") {
+        file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        file.open(path, ios::binary);
+        if (!file) {
+            cerr << RED << "Unable to open " << path << ".\n" << RESET;
+            return 1;
+        }
+        inputBytes = filesystem::file_size(path);
+    }
+    istream& in = path == "-" ? cin : file;
+
+    ImportCounters counters;
+    auto start = chrono::steady_clock::now();
+    auto elapsed = [&] { return max(chrono::duration<double>(chrono::steady_clock::now() - start).count(), 1e-9); };
+    mutex progressLock;
+    condition_variable progressDone;
+    bool finished = false;
+    thread progress([&] {
+        unique_lock<mutex> lock(progressLock);
+        while (!progressDone.wait_for(lock, chrono::seconds(1), [&] { return finished; })) {
+            cerr << "  " << counters.imported << " imported, " << counters.duplicates << " duplicates, "
+                << counters.invalid << " invalid, " << fixed << setprecision(0) << counters.imported / elapsed() << " users/sec";
+            if (inputBytes > 0) cerr << ", " << setprecision(1) << 100.0 * counters.bytesRead / inputBytes << "% read";
+            cerr << "\n";
+        }
+    });
+    auto stopProgress = [&] {
+        {
+            lock_guard<mutex> lock(progressLock);
+            finished = true;
+        }
+        progressDone.notify_all();
+        progress.join();
+    };
+    try {
+        users.importUsers(in, counters);
+    }
+    catch (...) {
+        stopProgress();
+        throw;
+    }
+    stopProgress();
+
+    double seconds = elapsed();
+    cerr << GREEN << "Imported " << counters.imported << " of " << counters.lines << " users in " << fixed << setprecision(1)
+        << seconds << " s (" << setprecision(0) << counters.imported / seconds << " users/sec); "
+        << counters.duplicates << " duplicates and " << counters.invalid << " invalid lines skipped\n" << RESET;
+    return 0;
+}
+
+// Export every user as CSV to a file (or stdout for "-")
+int runExport(const UserManager& users, const string& path) {
+    ofstream file;
+    if (path != "-") {
+        file.open(path, ios::binary | ios::trunc);
+        if (!file) {
+            cerr << RED << "Unable to open " << path << ".\n" << RESET;
+            return 1;
+        }
+    }
+    auto start = chrono::steady_clock::now();
+    uint64_t skipped;
+    uint64_t exported = users.exportUsers(path == "-" ? cout : file, skipped);
+    double seconds = max(chrono::duration<double>(chrono::steady_clock::now() - start).count(), 1e-9);
+    cerr << GREEN << "Exported " << exported << " users in " << fixed << setprecision(1) << seconds << " s ("
+        << setprecision(0) << exported / seconds << " users/sec)\n" << RESET;
+    if (skipped > 0) cerr << YELLOW << skipped << " users with a comma in their name were skipped.\n" << RESET;
+    return 0;
+}
+
+// Whole-string non-negative integer from a command-line value
+bool parseCount(string_view text, size_t& value) {
+    auto r = from_chars(text.data(), text.data() + text.size(), value);
+    return !text.empty() && r.ec == errc() && r.ptr == text.data() + text.size();
+}
+
+void printUsage(const char* program) {
+    cout << "Usage:\n"
+        << "  " << program << "                          Interactive mode\n"
+        << "  " << program << " --serve [SOCKET|-] [--workers N]\n"
+        << "      Answer REGISTER user password, LOGIN user password and STATS requests,\n"
+        << "      one per line, on a Unix domain socket (epoll event loop plus N worker\n"
+        << "      threads) or, with '-' (the default), on stdin/stdout\n"
+        << "  " << program << " --load SOCKET [--connections N] [--requests N] [--users N]\n"
+        << "      Register N users (default 1000) through a running server, then send N\n"
+        << "      logins (default 100000) over N connections (default 16) and report\n"
+        << "      auth ops/sec and latency percentiles\n"
+        << "  " << program << " --hash-bench [--hashes N] [--iterations N]\n"
+        << "      Check and time the scalar and multi-lane PBKDF2 kernels (default 256\n"
+        << "      hashes at 20000 iterations) and report hashes/sec per core\n"
+        << "  " << program << " --import FILE|- [--iterations N]\n"
+        << "      Add the users of a username,password CSV, hashing passwords at N\n"
+        << "      iterations (default 20000) unless they are already hashed, as in an\n"
+        << "      export; names already stored or repeated are skipped\n"
+        << "  " << program << " --export FILE|-\n"
+        << "      Write every user as username,password CSV with the stored hashes\n"
+        << "  --kernel scalar|avx2 overrides the CPU-detected hashing kernel; --serve\n"
+        << "  defaults to one worker per hashing lane on every core, and --iterations\n"
+        << "  also sets the cost of passwords it hashes\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        string servePath, loadPath, importPath, exportPath;
+        bool serve = false, hashBench = false;
+        unsigned workerCount = 0;
+        HashBenchOptions hashOptions;
+#ifdef __linux__
+        LoadOptions load;
+#endif
+        string badValue;
+        auto countValue = [&](const string& text) {
+            size_t value = 0;
+            if (!parseCount(text, value) && badValue.empty()) badValue = text;
+            return value;
+        };
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--serve") {
+                serve = true;
+                servePath = i + 1 < argc && string(argv[i + 1]).rfind("--", 0) != 0 ? argv[++i] : "-";
+            }
+            else if (arg == "--workers" && i + 1 < argc) {
+                workerCount = max(1u, static_cast<unsigned>(min<size_t>(countValue(argv[++i]), 4096)));
+            }
+            else if (arg == "--kernel" && i + 1 < argc) {
+                if (!selectHashKernel(argv[++i])) {
+                    cerr << RED << "Unknown or unsupported kernel: " << argv[i] << RESET << endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--import" && i + 1 < argc) {
+                importPath = argv[++i];
+            }
+            else if (arg == "--export" && i + 1 < argc) {
+                exportPath = argv[++i];
+            }
+            else if (arg == "--hash-bench") {
+                hashBench = true;
+            }
+            else if (arg == "--hashes" && i + 1 < argc) {
+                hashOptions.hashes = countValue(argv[++i]);
+            }
+            else if (arg == "--iterations" && i + 1 < argc) {
+                hashOptions.iterations = max(1u, static_cast<uint32_t>(min<size_t>(countValue(argv[++i]), UINT32_MAX)));
+            }
+#ifdef __linux__
+            else if (arg == "--load" && i + 1 < argc) {
+                loadPath = load.socketPath = argv[++i];
+            }
+            else if (arg == "--connections" && i + 1 < argc) {
+                load.connections = max(1u, static_cast<unsigned>(min<size_t>(countValue(argv[++i]), UINT32_MAX)));
+            }
+            else if (arg == "--requests" && i + 1 < argc) {
+                load.requests = countValue(argv[++i]);
+            }
+            else if (arg == "--users" && i + 1 < argc) {
+                load.users = countValue(argv[++i]);
+            }
+#endif
+            else {
+                printUsage(argv[0]);
+                return arg == "--help" ? 0 : 1;
+            }
+        }
+        if (!badValue.empty()) {
+            cerr << RED << "Not a valid number: " << badValue << RESET << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        // Workers mostly wait on the hasher, so keep enough of them busy to fill its lanes
+        if (workerCount == 0) {
+            workerCount = max(1u, thread::hardware_concurrency()) * static_cast<unsigned>(activeHashKernel().lanes);
+        }
+        try {
+            if (hashBench) return runHashBenchmark(hashOptions);
+#ifdef __linux__
+            if (!loadPath.empty()) return runLoadGenerator(load);
+#endif
+            if (!serve && importPath.empty() && exportPath.empty()) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            UserManager userManager(hashOptions.iterations);
+            if (!importPath.empty()) {
+                int status = runImport(userManager, importPath);
+                if (status != 0 || exportPath.empty()) return status;
+            }
+            if (!exportPath.empty()) return runExport(userManager, exportPath);
+            if (servePath == "-") return runStdinService(userManager, workerCount);
+#ifdef __linux__
+            return runSocketService(userManager, servePath, workerCount);
+#else
+            cerr << RED << "Socket service mode needs Linux (epoll); use --serve - instead.\n" << RESET;
+            return 1;
+#endif
+        }
+        catch (const exception& e) {
+            cerr << RED << "Error: " << e.what() << RESET << endl;
+            return 1;
+        }
+    }
+
+    try {
+        UserManager userManager;
+        int choice;
+
+        while (true) {
+            displayMenu();
+
+            if (!(cin >> choice)) {
+                if (cin.eof()) return 0;
+                cout << RED << "Please enter a valid numeric option.\n" << RESET;
+                clearInput();
+                continue;
+            }
+
+            switch (choice) {
+            case 1:
+                userManager.registerUser();
+                break;
+            case 2:
+                userManager.loginUser();
+                break;
+            case 3:
+                userManager.printStats();
+                break;
+            case 4:
+                cout << CYAN << "Thank you for using the system. Goodbye!\n" << RESET;
+                return 0;
+            default:
+                cout << RED << "Invalid option. Try again.\n" << RESET;
+            }
+        }
+    }
+    catch (const exception& e) {
+        cout << RED << "Error: " << e.what() << RESET << endl;
+        return 1;
+    }
     return 0;
 }